@@ -21,6 +21,8 @@ Outlets:
 Internal Signal flow:
   inlet -> input_buffer -> output_buffer -> outlet
 
+Developer note: both ringbuffers are mirrored, so chunks are moved without handling the wrap-around.
+
 */
 
 #include <m_pd.h>
@@ -65,28 +67,12 @@ t_int *delay_tilde_perform (t_int * w) {
 
   //If a new chunk is available in the input buffer, then copy it to the output buffer.
   if (t_sample_buffer_has_chunk (x->input_buffer)) {
-    bool free_required = false;
-    float *out_chunk;
-    t_sample_buffer_pop_chunk (x->input_buffer, &out_chunk, x->input_buffer->chunk_size, &free_required);
-    t_sample_buffer_add_chunk (x->output_buffer, out_chunk, x->input_buffer->chunk_size);
-
-    if (free_required) {
-      free (out_chunk);
-    }
+    t_sample *chunk = t_sample_buffer_pop_chunk (x->input_buffer, x->input_buffer->chunk_size);
+    t_sample_buffer_add_chunk (x->output_buffer, chunk, x->input_buffer->chunk_size);
   }
   //If a new chunk is available in the output buffer, then copy it to the outlet.
   if (t_sample_buffer_has_chunk (x->output_buffer)) {
-    bool free_required = false;
-    float *out_chunk;
-    t_sample_buffer_pop_chunk (x->output_buffer, &out_chunk, x->output_buffer->chunk_size, &free_required);
-
-    for (int i = 0; i < x->output_buffer->chunk_size; i++) {
-      out[i] = out_chunk[i];
-    }
-
-    if (free_required) {
-      free (out_chunk);
-    }
+    t_sample_buffer_pop_chunk_to (x->output_buffer, out, x->output_buffer->chunk_size);
   } else {
     //No new chunk available: send silence
     for (int i = 0; i < n; i++) {
@@ -120,8 +106,8 @@ void delay_tilde_dsp (t_delay_tilde * x, t_signal ** sp) {
   //Re-allocate ringbuffers
   delay_free_internal (x);
 
-  x->input_buffer = t_sample_buffer_alloc (MAX_BUFFER, sp[0]->s_n);
-  x->output_buffer = t_sample_buffer_alloc (MAX_BUFFER, sp[0]->s_n);
+  x->input_buffer = t_sample_buffer_alloc_mirrored (MAX_BUFFER, sp[0]->s_n);
+  x->output_buffer = t_sample_buffer_alloc_mirrored (MAX_BUFFER, sp[0]->s_n);
   x->block_size = sp[0]->s_n;
 
   dsp_add (delay_tilde_perform, 4, x, sp[0]->s_vec, sp[1]->s_vec, sp[0]->s_n);
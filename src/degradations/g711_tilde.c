@@ -5,31 +5,40 @@
 @license GPLv3 or later
 
 g711~ encodes the signal with [G.711](http://en.wikipedia.org/wiki/G.711) (8kHz).
-Packet-loss concealment is available: UGST/ITU-T G711 Appendix I PLC MODULE.
+Packet-loss concealment is available: UGST/ITU-T G711 Appendix I PLC MODULE (optimized pitch search, see g711_plc.h).
+Companding: A-law and µ-law (table-driven; bit-exact to ITU-T STL 2009, see g711_table.h).
 
 Parameters:
-  g711~ FRAME_SIZE PACKET_LOSS_CONCEALMENT
+  g711~ FRAME_SIZE PACKET_LOSS_CONCEALMENT RESAMPLER_QUALITY CHANNELS LAW
 
   FRAME_SIZE in  samples: 80, 160, 240
   PACKET_LOSS_CONCEALMENT: 0 (zero insertion) [default] and 1 (UGST/ITU-T G711 Appendix I)
+  RESAMPLER_QUALITY: 0 (medium) [default], 1 (low latency), 2 (high)
+  CHANNELS: number of independent signals (default: 1)
+  LAW: 0 (A-law) [default], 1 (µ-law)
 
 Inlets:
-  1x Audio inlet
+  CHANNELS x Audio inlet
   also bang: lose next frame
+  also latency: posts the latency (constant; prefill and resampler)
+  also worker 0/1: processes the frames on worker threads (adds one frame of latency; applied on the next DSP start)
+  also phase N: shifts the frame boundaries by N samples (internal sample rate; -1: automatic [default]; applied on the next DSP start)
 
 Outlets:
-  1x Audio outlet
+  CHANNELS x Audio outlet
+
+Developer note: the PLC of Appendix I works on sub-frames of FRAMESZ (80) samples; frames of 160 and 240 samples are processed as two or three sub-frames.
 
 */
 
 #include <m_pd.h>
-#include <limits.h>
 #include <string.h>
 #include "ringbuffer.h"
 #include "generic_codec.h"
+#include "convert.h"
 
-#include "g711.h"
-#include "lowcfe.h"             //Packet loss concealment
+#include "g711_table.h"
+#include "g711_plc.h"           //Packet loss concealment (lowcfe.h)
 
 static t_class *g711_tilde_class;
 
@@ -40,87 +49,80 @@ typedef struct _g711_tilde {
 
   t_float float_inlet_unused;
 
-  LowcFE_c lc;                  //G.711 packet loss concealment
+  LowcFE_c *lc;                 //G.711 packet loss concealment (one per channel)
 
   unsigned int packet_loss_concealment_mode;
-} t_g711_tilde;
 
-void g711_add_to_outbuffer (t_g711_tilde * x);
-
-t_int *g711_tilde_perform (t_int * w) {
-  t_g711_tilde *x = (t_g711_tilde *) (w[1]);
-  t_sample *in = (t_sample *) (w[2]);
-  t_sample *out = (t_sample *) (w[3]);
-  int n = (int) (w[4]);
+  const t_g711_table *table;    //A-law or µ-law
+} t_g711_tilde;
 
-  generic_codec_resample_to_internal (&x->codec, n, in);
-  if (float_buffer_has_chunk (x->codec.ringbuffer_input)) {
-    g711_add_to_outbuffer (x);
-  }
+void g711_process_frames (t_g711_tilde * x, unsigned int channel, unsigned int n, float *frames) {
+  unsigned int frame_size = x->codec.frame_size;
+
+  for (unsigned int f = 0; f < n; f++) {
+    float *frame = &frames[f * frame_size];
+
+    //Encode
+    short raw[frame_size];
+    convert_float_to_short (frame, raw, frame_size);
+    uint8_t compressed[frame_size];
+    g711_table_compress (x->table, frame_size, raw, compressed);
+
+    //Decode
+    if (x->codec.drop_next_frame[channel]) {
+      switch (x->packet_loss_concealment_mode) {
+      case 1:
+        for (unsigned int i = 0; i < frame_size; i += FRAMESZ) {
+          g711_plc_dofe (&x->lc[channel], &raw[i]);
+        }
+        break;
+      default:
+        memset (raw, 0, frame_size * sizeof (short));   //zero insertion
+      }
+      x->codec.drop_next_frame[channel] = false;
+    } else {
+      g711_table_expand (x->table, frame_size, compressed, raw);
+      for (unsigned int i = 0; i < frame_size; i += FRAMESZ) {
+        g711_plc_addtohistory (&x->lc[channel], &raw[i]);
+      }
+    }
 
-  if (float_buffer_has_chunk (x->codec.ringbuffer_output)) {
-    generic_codec_to_outbuffer (&x->codec, out);
+    convert_short_to_float (raw, frame, frame_size);
   }
-
-  return (w + 5);
 }
 
-void g711_add_to_outbuffer (t_g711_tilde * x) {
-  bool free_required = false;
-  float *frame;
-  float_buffer_pop_chunk (x->codec.ringbuffer_input, &frame, x->codec.ringbuffer_input->chunk_size, &free_required);
-
-  //Encode
-  short raw[x->codec.ringbuffer_input->chunk_size];
-  for (int i = 0; i < x->codec.ringbuffer_input->chunk_size; i++) {
-    raw[i] = SHRT_MAX * frame[i];
-  }
-  short compressed[x->codec.ringbuffer_input->chunk_size];
-  alaw_compress (x->codec.ringbuffer_input->chunk_size, raw, compressed);
-
-  //Decode
-  if (x->codec.drop_next_frame) {
-    switch (x->packet_loss_concealment_mode) {
-    case 1:
-      g711plc_dofe (&x->lc, raw);
-      break;
-    default:
-      memset (raw, 0, x->codec.ringbuffer_input->chunk_size * sizeof (short));  //zero insertion
-    }
-    x->codec.drop_next_frame = false;
-  } else {
-    short uncompressed[x->codec.ringbuffer_input->chunk_size];
-    alaw_expand (x->codec.ringbuffer_input->chunk_size, compressed, uncompressed);
-
-    g711plc_addtohistory (&x->lc, uncompressed);
-
-    memcpy (raw, uncompressed, x->codec.ringbuffer_input->chunk_size * sizeof (short));
-  }
+void g711_packet_loss (t_g711_tilde * x) {
+  generic_codec_drop_next_frame (&x->codec);
+}
 
-  //Copy to outbuffer
-  for (int i = 0; i < x->codec.ringbuffer_input->chunk_size; i++) {
-    frame[i] = (float) raw[i] / SHRT_MAX;
-  }
-  generic_codec_resample_to_external (&x->codec, x->codec.ringbuffer_input->chunk_size, frame);
+void g711_latency (t_g711_tilde * x) {
+  generic_codec_post_latency (&x->codec, "g711~");
+}
 
-  if (free_required) {
-    free (frame);
-  }
+void g711_worker (t_g711_tilde * x, t_floatarg worker) {
+  generic_codec_set_worker (&x->codec, "g711~", worker != 0);
 }
 
-void g711_packet_loss (t_g711_tilde * x) {
-  x->codec.drop_next_frame = true;
+void g711_phase (t_g711_tilde * x, t_floatarg phase) {
+  generic_codec_set_phase (&x->codec, "g711~", phase);
 }
 
 void g711_tilde_dsp (t_g711_tilde * x, t_signal ** sp) {
-  generic_codec_dsp_add (&x->codec, sp[0]->s_n, x, g711_tilde_perform, sp);
+  generic_codec_dsp_stop (&x->codec);
+
+  for (unsigned int channel = 0; channel < x->codec.channels; channel++) {
+    g711plc_construct (&x->lc[channel]);
+  }
+
+  generic_codec_dsp_add (&x->codec, sp[0]->s_n, &x->codec, generic_codec_perform, sp);
 }
 
 void g711_tilde_free (t_g711_tilde * x) {
   generic_codec_free (&x->codec);
+  free (x->lc);
 }
 
-void *g711_tilde_new (t_floatarg frame_size, t_floatarg packet_loss_concealment_mode) {
+void *g711_tilde_new (t_floatarg frame_size, t_floatarg packet_loss_concealment_mode, t_floatarg resampler_quality, t_floatarg channels, t_floatarg law) {
   t_g711_tilde *x = (t_g711_tilde *) pd_new (g711_tilde_class);
 
   //Parameters
@@ -129,24 +131,47 @@ void *g711_tilde_new (t_floatarg frame_size, t_floatarg packet_loss_concealment_
     frame_size = 80;
   }
 
-  if (packet_loss_concealment_mode < 0 && packet_loss_concealment_mode > 1) {
+  if (packet_loss_concealment_mode < 0 || packet_loss_concealment_mode > 1) {
     error ("g711~: invalid packet loss concealment mode specified (%d). Using mode 0.", (int) packet_loss_concealment_mode);
     packet_loss_concealment_mode = 0;
   }
   x->packet_loss_concealment_mode = packet_loss_concealment_mode;
 
+  if ((int) resampler_quality < 0 || (int) resampler_quality > 2) {
+    error ("g711~: invalid resampler quality specified (%d). Using 0 (medium).", (int) resampler_quality);
+    resampler_quality = RESAMPLER_QUALITY_MEDIUM;
+  }
+
+  if ((int) channels == 0) {
+    channels = 1;               //Default: mono
+  }
+  if ((int) channels < 1 || (int) channels > GENERIC_CODEC_CHANNELS_MAX) {
+    error ("g711~: invalid number of channels specified (%d). Using 1.", (int) channels);
+    channels = 1;
+  }
+
+  if ((int) law != G711_TABLE_ALAW && (int) law != G711_TABLE_ULAW) {
+    error ("g711~: invalid law specified (%d). Using 0 (A-law).", (int) law);
+    law = G711_TABLE_ALAW;
+  }
+  g711_table_init ();
+  x->table = &g711_tables[(int) law];
+
   //Initialize
-  generic_codec_init (&x->codec, &x->x_obj, 8000, frame_size);
-  g711plc_construct (&x->lc);
+  generic_codec_init (&x->codec, &x->x_obj, 8000, frame_size, resampler_quality, channels, (t_generic_codec_process_frames) g711_process_frames);
+  x->lc = malloc (channels * sizeof (LowcFE_c));  //Initialized on DSP start
 
-  post ("g711~: Created with frame size (%d) and packet loss concealment mode (%d).", x->codec.frame_size, x->packet_loss_concealment_mode);
+  post ("g711~: Created with frame size (%d), packet loss concealment mode (%d), channels (%d), and %s.", x->codec.frame_size, x->packet_loss_concealment_mode, x->codec.channels, (int) law == G711_TABLE_ULAW ? "µ-law" : "A-law");
 
   return (void *) x;
 }
 
 void g711_tilde_setup (void) {
-  g711_tilde_class = class_new (gensym ("g711~"), (t_newmethod) g711_tilde_new, (t_method) g711_tilde_free, sizeof (t_g711_tilde), CLASS_DEFAULT, A_DEFFLOAT, A_DEFFLOAT, 0);
+  g711_tilde_class = class_new (gensym ("g711~"), (t_newmethod) g711_tilde_new, (t_method) g711_tilde_free, sizeof (t_g711_tilde), CLASS_DEFAULT, A_DEFFLOAT, A_DEFFLOAT, A_DEFFLOAT, A_DEFFLOAT, A_DEFFLOAT, 0);
   class_addmethod (g711_tilde_class, (t_method) g711_tilde_dsp, gensym ("dsp"), 0);
+  class_addmethod (g711_tilde_class, (t_method) g711_latency, gensym ("latency"), 0);
+  class_addmethod (g711_tilde_class, (t_method) g711_worker, gensym ("worker"), A_FLOAT, 0);
+  class_addmethod (g711_tilde_class, (t_method) g711_phase, gensym ("phase"), A_FLOAT, 0);
   class_addbang (g711_tilde_class, g711_packet_loss);
   CLASS_MAINSIGNALIN (g711_tilde_class, t_g711_tilde, float_inlet_unused);
   class_sethelpsymbol (g711_tilde_class, gensym ("g711~"));
@@ -1,5 +1,5 @@
 /**
-@file g711_tilde.c
+@file g722_tilde.c
 @author Frank Haase, Dennis Guse
 @date 2016-08-24
 @license GPLv3 or later
@@ -8,28 +8,34 @@ g722~ encodes the signal with [G.722](http://en.wikipedia.org/wiki/G.722) (16kHz
 The signal temporary sampled to 16kHz.
 
 Parameters:
-  g722~ FRAME_SIZE COMPRESSION_MODE PACKET_LOSS_CONCEALMENT
+  g722~ FRAME_SIZE PACKET_LOSS_CONCEALMENT COMPRESSION_MODE RESAMPLER_QUALITY CHANNELS
 
   FRAME_SIZE in samples: 160, 320
+  PACKET_LOSS_CONCEALMENT: 0 (zero insertion) [default], 1 (zero insertion, decoder reset), 2 (pitch-based waveform repetition, decoder re-convergence; see g722_plc.h)
   COMPRESSION_MODE: 0 (64kbit/s) [default], 1 (56kbit/s), 2 (48kbit/s)
-  PACKET_LOSS_CONCEALMENT: 0 (zero insertion) [default], 1 (zero insertion, decoder reset)
+  RESAMPLER_QUALITY: 0 (medium) [default], 1 (low latency), 2 (high)
+  CHANNELS: number of independent signals (default: 1)
 
 Inlets:
-  1x Audio inlet
+  CHANNELS x Audio inlet
   also bang: lose next frame
+  also latency: posts the latency (constant; prefill and resampler)
+  also worker 0/1: processes the frames on worker threads (adds one frame of latency; applied on the next DSP start)
+  also phase N: shifts the frame boundaries by N samples (internal sample rate; -1: automatic [default]; applied on the next DSP start)
 
 Outlets:
-  1x Audio outlet
+  CHANNELS x Audio outlet
 
 */
 
 #include <m_pd.h>
-#include <limits.h>
 #include <stdbool.h>
 #include <string.h>
 #include "g722.h"
+#include "g722_plc.h"
 #include "ringbuffer.h"
 #include "generic_codec.h"
+#include "convert.h"
 
 static t_class *g722_tilde_class;
 
@@ -38,122 +44,104 @@ typedef struct _g722_tilde {
 
   t_generic_codec codec;
 
-  g722_encode_state_t *encoder;
-  g722_decode_state_t *decoder;
+  g722_encode_state_t *encoder;        //One per channel
+  g722_decode_state_t *decoder;        //One per channel
+  t_g722_plc *plc;              //One per channel
 
-  int g722_decoding_mode;       //The decoder modes [internal] (8 = 64kbit/s; 7 = 56kbit/s; 6 = 48kbit/s)
+  int bit_rate;                 //64000, 56000 or 48000
 
   unsigned int packet_loss_concealment_mode;
 
   t_float float_inlet_unused;
 } t_g722_tilde;
 
-void g722_add_to_outbuffer (t_g722_tilde * x);
-
-t_int *g722_tilde_perform (t_int * w) {
-  t_g722_tilde *x = (t_g722_tilde *) (w[1]);
-  t_sample *in = (t_sample *) (w[2]);
-  t_sample *out = (t_sample *) (w[3]);
-  int n = (int) (w[4]);
-
-  generic_codec_resample_to_internal (&x->codec, n, in);
-
-  if (float_buffer_has_chunk (x->codec.ringbuffer_input)) {
-    g722_add_to_outbuffer (x);
-  }
-
-  if (float_buffer_has_chunk (x->codec.ringbuffer_output)) {
-    generic_codec_to_outbuffer (&x->codec, out);
-  }
-
-  return (w + 5);
-}
-
-void g722_add_to_outbuffer (t_g722_tilde * x) {
-  bool free_required = false;
-  float *frame;
-  float_buffer_pop_chunk (x->codec.ringbuffer_input, &frame, x->codec.ringbuffer_input->chunk_size, &free_required);
-
-  //Encode
-  short raw[x->codec.frame_size];
-  for (int i = 0; i < x->codec.frame_size; i++) {
-    raw[i] = SHRT_MAX * frame[i];
-  }
-  uint8_t encoded[x->codec.frame_size];
-  int encoded_length = g722_encode (x->encoder, encoded, raw, x->codec.frame_size);
-
-  //Decode ATTENTION: decoded_length varies
-  if (x->codec.drop_next_frame) {
-    switch (x->packet_loss_concealment_mode) {
-    case 0:
-      memset (raw, 0, x->codec.ringbuffer_input->chunk_size * sizeof (short));  //zero insertion
-      break;
-    case 1:
-      g722_decode_release (x->decoder);
-      g722_decode_init (x->decoder, x->codec.sample_rate_internal, x->g722_decoding_mode);
-      memset (raw, 0, x->codec.frame_size * sizeof (short));    //zero insertion
-      break;
+void g722_process_frames (t_g722_tilde * x, unsigned int channel, unsigned int n, float *frames) {
+  unsigned int frame_size = x->codec.frame_size;
+
+  for (unsigned int f = 0; f < n; f++) {
+    float *frame = &frames[f * frame_size];
+
+    //Encode
+    short raw[frame_size];
+    convert_float_to_short (frame, raw, frame_size);
+    uint8_t encoded[frame_size];
+    int encoded_length = g722_encode (&x->encoder[channel], encoded, raw, frame_size);
+
+    //Decode
+    int decoded_length = frame_size;
+    if (x->codec.drop_next_frame[channel]) {
+      switch (x->packet_loss_concealment_mode) {
+      case 0:
+        memset (raw, 0, frame_size * sizeof (short));   //zero insertion
+        break;
+      case 1:
+        g722_decode_init (&x->decoder[channel], x->bit_rate, 0);       //Reset
+        memset (raw, 0, frame_size * sizeof (short));   //zero insertion
+        break;
+      case 2:
+        g722_plc_conceal (&x->plc[channel], &x->decoder[channel], raw, frame_size);
+        break;
+      }
+      x->codec.drop_next_frame[channel] = false;
+    } else {
+      decoded_length = g722_decode (&x->decoder[channel], raw, encoded, encoded_length);
+      if (x->packet_loss_concealment_mode == 2) {
+        g722_plc_receive (&x->plc[channel], raw, decoded_length);
+      }
     }
-    x->codec.drop_next_frame = false;
 
-    //Copy to outbuffer
-    for (int i = 0; i < x->codec.frame_size; i++) {
-      frame[i] = (float) raw[i] / SHRT_MAX;
+    convert_short_to_float (raw, frame, decoded_length);
+    for (int i = decoded_length; i < (int) frame_size; i++) {
+      frame[i] = 0;
     }
-    generic_codec_resample_to_external (&x->codec, x->codec.frame_size, frame);
+  }
+}
 
-  } else {
-    int16_t decoded[x->codec.frame_size];
-    int decoded_length = g722_decode (x->decoder, decoded, encoded, encoded_length);
 
-    //Copy to outbuffer
-    for (int i = 0; i < decoded_length; i++) {
-      frame[i] = (float) decoded[i] / SHRT_MAX;
-    }
-    generic_codec_resample_to_external (&x->codec, decoded_length, frame);
-  }
+void g722_packet_loss (t_g722_tilde * x) {
+  generic_codec_drop_next_frame (&x->codec);
+}
 
-  if (free_required) {
-    free (frame);
-  }
+void g722_latency (t_g722_tilde * x) {
+  generic_codec_post_latency (&x->codec, "g722~");
 }
 
+void g722_worker (t_g722_tilde * x, t_floatarg worker) {
+  generic_codec_set_worker (&x->codec, "g722~", worker != 0);
+}
 
-void g722_packet_loss (t_g722_tilde * x) {
-  x->codec.drop_next_frame = true;
+void g722_phase (t_g722_tilde * x, t_floatarg phase) {
+  generic_codec_set_phase (&x->codec, "g722~", phase);
 }
 
 void g722_tilde_dsp (t_g722_tilde * x, t_signal ** sp) {
-  x->encoder = (g722_encode_state_t *) malloc (sizeof (g722_encode_state_t));
-  g722_encode_init (x->encoder, x->codec.sample_rate_internal, x->g722_decoding_mode);
+  generic_codec_dsp_stop (&x->codec);
 
-  x->decoder = (g722_decode_state_t *) malloc (sizeof (g722_decode_state_t));
-  g722_decode_init (x->decoder, x->codec.sample_rate_internal, x->g722_decoding_mode);
+  for (unsigned int channel = 0; channel < x->codec.channels; channel++) {
+    g722_encode_init (&x->encoder[channel], x->bit_rate, 0);
+    g722_decode_init (&x->decoder[channel], x->bit_rate, 0);
+    g722_plc_init (&x->plc[channel]);
+  }
 
-  generic_codec_dsp_add (&x->codec, sp[0]->s_n, x, g722_tilde_perform, sp);
+  generic_codec_dsp_add (&x->codec, sp[0]->s_n, &x->codec, generic_codec_perform, sp);
 }
 
 void g722_tilde_free (t_g722_tilde * x) {
   generic_codec_free (&x->codec);
-  if (x->encoder != NULL) {
-    g722_encode_release (x->encoder);
-    x->encoder = NULL;
-  }
-  if (x->decoder != NULL) {
-    g722_decode_release (x->decoder);
-    x->decoder = NULL;
-  }
+  free (x->encoder);
+  free (x->decoder);
+  free (x->plc);
 }
 
-void *g722_tilde_new (t_floatarg frame_size, t_floatarg packet_loss_concealment_mode, t_floatarg g722_decoding_mode) {
+void *g722_tilde_new (t_floatarg frame_size, t_floatarg packet_loss_concealment_mode, t_floatarg g722_decoding_mode, t_floatarg resampler_quality, t_floatarg channels) {
   t_g722_tilde *x = (t_g722_tilde *) pd_new (g722_tilde_class);
 
   if ((int) frame_size != 160 && frame_size != 320) {
-    error ("g722~: invalid frame size specified (%i). Using 160.", (int) packet_loss_concealment_mode);
+    error ("g722~: invalid frame size specified (%i). Using 160.", (int) frame_size);
     frame_size = 160;
   }
 
-  if (packet_loss_concealment_mode < 0 && packet_loss_concealment_mode > 1) {
+  if ((int) packet_loss_concealment_mode < 0 || (int) packet_loss_concealment_mode > 2) {
     error ("g722~: invalid packet loss concealment mode specified (%d). Using mode 0.", (int) packet_loss_concealment_mode);
     packet_loss_concealment_mode = 0;
   }
@@ -163,22 +151,37 @@ void *g722_tilde_new (t_floatarg frame_size, t_floatarg packet_loss_concealment_
     error ("g722~: invalid g722 decoding mode specified (%d). Using mode 0.", (int) g722_decoding_mode);
     g722_decoding_mode = 0;
   }
-  x->g722_decoding_mode = g722_decoding_mode;
+  if ((int) resampler_quality < 0 || (int) resampler_quality > 2) {
+    error ("g722~: invalid resampler quality specified (%d). Using 0 (medium).", (int) resampler_quality);
+    resampler_quality = RESAMPLER_QUALITY_MEDIUM;
+  }
+
+  if ((int) channels == 0) {
+    channels = 1;               //Default: mono
+  }
+  if ((int) channels < 1 || (int) channels > GENERIC_CODEC_CHANNELS_MAX) {
+    error ("g722~: invalid number of channels specified (%d). Using 1.", (int) channels);
+    channels = 1;
+  }
 
-  post ("g722~: Created with frame size (%d), packet-loss concealment mode (%d), and decoding mode (%d).", frame_size, x->packet_loss_concealment_mode, x->g722_decoding_mode);
+  post ("g722~: Created with frame size (%d), packet-loss concealment mode (%d), decoding mode (%d), and channels (%d).", (int) frame_size, x->packet_loss_concealment_mode, (int) g722_decoding_mode, (int) channels);
 
-  x->g722_decoding_mode = 8 - g722_decoding_mode;       //Decoding mode transformed for g722.h
+  x->bit_rate = 64000 - 8000 * (int) g722_decoding_mode;        //Decoding mode transformed for g722.h
 
-  generic_codec_init (&x->codec, &x->x_obj, 16000, frame_size);
+  generic_codec_init (&x->codec, &x->x_obj, 16000, frame_size, resampler_quality, channels, (t_generic_codec_process_frames) g722_process_frames);
 
-  x->encoder = NULL;
-  x->decoder = NULL;
+  x->encoder = malloc (channels * sizeof (g722_encode_state_t));
+  x->decoder = malloc (channels * sizeof (g722_decode_state_t));
+  x->plc = malloc (channels * sizeof (t_g722_plc));
   return (void *) x;
 }
 
 void g722_tilde_setup (void) {
-  g722_tilde_class = class_new (gensym ("g722~"), (t_newmethod) g722_tilde_new, (t_method) g722_tilde_free, sizeof (t_g722_tilde), CLASS_DEFAULT, A_DEFFLOAT, 0);
+  g722_tilde_class = class_new (gensym ("g722~"), (t_newmethod) g722_tilde_new, (t_method) g722_tilde_free, sizeof (t_g722_tilde), CLASS_DEFAULT, A_DEFFLOAT, A_DEFFLOAT, A_DEFFLOAT, A_DEFFLOAT, A_DEFFLOAT, 0);
   class_addmethod (g722_tilde_class, (t_method) g722_tilde_dsp, gensym ("dsp"), 0);
+  class_addmethod (g722_tilde_class, (t_method) g722_latency, gensym ("latency"), 0);
+  class_addmethod (g722_tilde_class, (t_method) g722_worker, gensym ("worker"), A_FLOAT, 0);
+  class_addmethod (g722_tilde_class, (t_method) g722_phase, gensym ("phase"), A_FLOAT, 0);
   class_addbang (g722_tilde_class, g722_packet_loss);
   CLASS_MAINSIGNALIN (g722_tilde_class, t_g722_tilde, float_inlet_unused);
 }
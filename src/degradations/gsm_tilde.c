@@ -5,121 +5,193 @@
 @license GPLv3 or later
 
 gsm~ encodes the signal with [GSM Full rate / GSM 6.10](http://en.wikipedia.org/wiki/Full_Rate) (8kHz).
+Lost frames are substituted and muted similar to GSM 06.11 (see gsm_plc.h).
 
 Parameters:
-  gsm10~
+  gsm~ RESAMPLER_QUALITY CHANNELS LOSS_PROBABILITY SEED
+
+  RESAMPLER_QUALITY: 0 (medium) [default], 1 (low latency), 2 (high)
+  CHANNELS: number of independent signals (default: 1)
+  LOSS_PROBABILITY: probability that a frame is lost (0 to 1; independent per frame and channel; default: 0)
+  SEED: seed of the random losses (positive integer); 0: number of the instance in creation order [default]
 
 Inlets:
-  1x Audio inlet
-  also bang: lose next frame (not implemented)
+  CHANNELS x Audio inlet
+  also bang: lose next frame
+  also latency: posts the latency (constant; prefill and resampler)
+  also worker 0/1: processes the frames on worker threads (adds one frame of latency; applied on the next DSP start)
+  also phase N: shifts the frame boundaries by N samples (internal sample rate; -1: automatic [default]; applied on the next DSP start)
 
 Outlets:
-  1x Audio outlet
+  CHANNELS x Audio outlet
+
+Developer note: the random number generator of each channel is reset to its seed (derived from SEED) on DSP start, so the loss pattern is reproducible.
+Developer note: the GSM encoders and decoders are created in new and kept on DSP restart (libgsm provides no reset; its state adapts to the signal within a few frames).
 
 */
 
 #include <m_pd.h>
-#include <limits.h>
 #include <stdbool.h>
 #include <string.h>
 #include "ringbuffer.h"
 #include "generic_codec.h"
+#include "convert.h"
+#include "gsm_plc.h"
 
 #include <gsm.h>
 
 static t_class *gsm_tilde_class;
 
+static uint32_t gsm_tilde_instances = 0;        //Number of created instances (default seed)
+
 typedef struct _gsm_tilde {
   t_object x_obj;
 
   t_generic_codec codec;
 
-  gsm decoder;
-  gsm encoder;
+  gsm *decoder;                 //One per channel
+  gsm *encoder;                 //One per channel
+  t_gsm_plc *plc;               //One per channel
+
+  float loss_probability;
+  uint32_t seed;                //Random number generator of channel i: seed + i (set in new)
 
   t_float float_inlet;
 } t_gsm_tilde;
 
-void gsm_add_to_outbuffer (t_gsm_tilde * x);
+void gsm_process_frames (t_gsm_tilde * x, unsigned int channel, unsigned int n, float *frames) {
+  unsigned int frame_size = x->codec.frame_size;
 
-t_int *gsm_tilde_perform (t_int * w) {
-  t_gsm_tilde *x = (t_gsm_tilde *) (w[1]);
-  t_sample *in = (t_sample *) (w[2]);
-  t_sample *out = (t_sample *) (w[3]);
-  int n = (int) (w[4]);
+  for (unsigned int f = 0; f < n; f++) {
+    float *frame = &frames[f * frame_size];
 
-  generic_codec_resample_to_internal (&x->codec, n, in);
+    short raw[frame_size];
+    convert_float_to_short (frame, raw, frame_size);
 
-  if (float_buffer_has_chunk (x->codec.ringbuffer_input)) {
-    gsm_add_to_outbuffer (x);
-  }
-
-  if (float_buffer_has_chunk (x->codec.ringbuffer_output)) {
-    generic_codec_to_outbuffer (&x->codec, out);
-  }
+    gsm_byte encoded[frame_size];
+    gsm_encode (x->encoder[channel], raw, encoded);
 
-  return (w + 5);
-}
+    bool lost = x->codec.drop_next_frame[channel];
+    x->codec.drop_next_frame[channel] = false;
+    if (x->loss_probability > 0 && gsm_plc_random (&x->plc[channel]) < (double) x->loss_probability * UINT32_MAX) {
+      lost = true;
+    }
 
-void gsm_add_to_outbuffer (t_gsm_tilde * x) {
-  bool free_required = false;
-  float *frame;
-  float_buffer_pop_chunk (x->codec.ringbuffer_input, &frame, x->codec.ringbuffer_input->chunk_size, &free_required);
+    if (lost) {
+      bool audible = gsm_plc_conceal (&x->plc[channel], x->decoder[channel], encoded);
+      gsm_decode (x->decoder[channel], encoded, raw);
+      if (!audible) {
+        memset (raw, 0, frame_size * sizeof (short));
+      }
+    } else {
+      gsm_plc_receive (&x->plc[channel], x->decoder[channel], encoded);
+      gsm_decode (x->decoder[channel], encoded, raw);
+    }
 
-  short raw[x->codec.frame_size];
-  for (int i = 0; i < x->codec.frame_size; i++) {
-    raw[i] = SHRT_MAX * frame[i];
+    convert_short_to_float (raw, frame, frame_size);
   }
+}
 
-  gsm_byte encoded[x->codec.frame_size];
-  gsm_encode (x->encoder, raw, encoded);
-  gsm_decode (x->decoder, encoded, raw);
+void gsm_packet_loss (t_gsm_tilde * x) {
+  generic_codec_drop_next_frame (&x->codec);
+}
 
-  for (int i = 0; i < x->codec.frame_size; i++) {
-    frame[i] = (float) raw[i] / SHRT_MAX;
-  }
-  generic_codec_resample_to_external (&x->codec, x->codec.ringbuffer_input->chunk_size, frame);
+void gsm_latency (t_gsm_tilde * x) {
+  generic_codec_post_latency (&x->codec, "gsm~");
+}
 
-  if (free_required) {
-    free (frame);
-  }
+void gsm_worker (t_gsm_tilde * x, t_floatarg worker) {
+  generic_codec_set_worker (&x->codec, "gsm~", worker != 0);
 }
 
-void gsm_packet_loss (t_gsm_tilde * x) {
-  x->codec.drop_next_frame = true;
-  error ("gsm~: Packet loss is not implemented.");
+void gsm_phase (t_gsm_tilde * x, t_floatarg phase) {
+  generic_codec_set_phase (&x->codec, "gsm~", phase);
 }
 
 void gsm_tilde_dsp (t_gsm_tilde * x, t_signal ** sp) {
-  x->decoder = gsm_create ();
-  x->encoder = gsm_create ();
+  for (unsigned int channel = 0; channel < x->codec.channels; channel++) {
+    if (x->encoder[channel] == NULL || x->decoder[channel] == NULL) {
+      error ("gsm~: GSM encoder and decoder are not available.");
+      return;
+    }
+  }
+  generic_codec_dsp_stop (&x->codec);
+
+  for (unsigned int channel = 0; channel < x->codec.channels; channel++) {
+    gsm_plc_init (&x->plc[channel], x->seed + channel);
+  }
 
-  generic_codec_dsp_add (&x->codec, sp[0]->s_n, x, gsm_tilde_perform, sp);
+  generic_codec_dsp_add (&x->codec, sp[0]->s_n, &x->codec, generic_codec_perform, sp);
 }
 
 void gsm_tilde_free (t_gsm_tilde * x) {
   generic_codec_free (&x->codec);
-  if (x->decoder != NULL) {
-    gsm_destroy (x->decoder);
-  }
-  if (x->encoder != NULL) {
-    gsm_destroy (x->encoder);
+
+  for (unsigned int channel = 0; channel < x->codec.channels; channel++) {
+    if (x->decoder[channel] != NULL) {
+      gsm_destroy (x->decoder[channel]);
+    }
+    if (x->encoder[channel] != NULL) {
+      gsm_destroy (x->encoder[channel]);
+    }
   }
+  free (x->decoder);
+  free (x->encoder);
+  free (x->plc);
 }
 
-void *gsm_tilde_new () {
+void *gsm_tilde_new (t_floatarg resampler_quality, t_floatarg channels, t_floatarg loss_probability, t_floatarg seed) {
   t_gsm_tilde *x = (t_gsm_tilde *) pd_new (gsm_tilde_class);
 
-  generic_codec_init (&x->codec, &x->x_obj, 8000, 160);
+  if ((int) resampler_quality < 0 || (int) resampler_quality > 2) {
+    error ("gsm~: invalid resampler quality specified (%d). Using 0 (medium).", (int) resampler_quality);
+    resampler_quality = RESAMPLER_QUALITY_MEDIUM;
+  }
+
+  if ((int) channels == 0) {
+    channels = 1;               //Default: mono
+  }
+  if ((int) channels < 1 || (int) channels > GENERIC_CODEC_CHANNELS_MAX) {
+    error ("gsm~: invalid number of channels specified (%d). Using 1.", (int) channels);
+    channels = 1;
+  }
 
-  x->encoder = NULL;
-  x->decoder = NULL;
+  if (loss_probability < 0 || loss_probability > 1) {
+    error ("gsm~: invalid loss probability specified (%g). Using 0.", loss_probability);
+    loss_probability = 0;
+  }
+  x->loss_probability = loss_probability;
+
+  gsm_tilde_instances++;
+  if ((int) seed < 0) {
+    error ("gsm~: invalid seed specified (%d). Using 0 (number of the instance).", (int) seed);
+    seed = 0;
+  }
+  //Seeds of the channels of different instances do not overlap
+  x->seed = ((int) seed == 0 ? gsm_tilde_instances : (uint32_t) seed) * GENERIC_CODEC_CHANNELS_MAX;
+
+  generic_codec_init (&x->codec, &x->x_obj, 8000, 160, resampler_quality, channels, (t_generic_codec_process_frames) gsm_process_frames);
+
+  x->encoder = calloc (channels, sizeof (gsm));
+  x->decoder = calloc (channels, sizeof (gsm));
+  x->plc = malloc (channels * sizeof (t_gsm_plc));
+  for (unsigned int channel = 0; channel < x->codec.channels; channel++) {
+    x->encoder[channel] = gsm_create ();
+    x->decoder[channel] = gsm_create ();
+    if (x->encoder[channel] == NULL || x->decoder[channel] == NULL) {
+      error ("gsm~: Creating GSM encoder and decoder failed.");
+      break;
+    }
+  }
   return (void *) x;
 }
 
 void gsm_tilde_setup (void) {
-  gsm_tilde_class = class_new (gensym ("gsm~"), (t_newmethod) gsm_tilde_new, (t_method) gsm_tilde_free, sizeof (t_gsm_tilde), CLASS_DEFAULT, 0);
+  gsm_tilde_class = class_new (gensym ("gsm~"), (t_newmethod) gsm_tilde_new, (t_method) gsm_tilde_free, sizeof (t_gsm_tilde), CLASS_DEFAULT, A_DEFFLOAT, A_DEFFLOAT, A_DEFFLOAT, A_DEFFLOAT, 0);
   class_addmethod (gsm_tilde_class, (t_method) gsm_tilde_dsp, gensym ("dsp"), 0);
+  class_addmethod (gsm_tilde_class, (t_method) gsm_latency, gensym ("latency"), 0);
+  class_addmethod (gsm_tilde_class, (t_method) gsm_worker, gensym ("worker"), A_FLOAT, 0);
+  class_addmethod (gsm_tilde_class, (t_method) gsm_phase, gensym ("phase"), A_FLOAT, 0);
   class_addbang (gsm_tilde_class, gsm_packet_loss);
   CLASS_MAINSIGNALIN (gsm_tilde_class, t_gsm_tilde, float_inlet);
   class_sethelpsymbol (gsm_tilde_class, gensym ("gsm~"));
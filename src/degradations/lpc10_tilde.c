@@ -7,14 +7,22 @@
 lpc10~ encodes the signal with [LPC-10](https://en.wikipedia.org/wiki/FS-1015) aka FS-1015 aka STANAG 4198 (8kHz).
 
 Parameters:
-  lpc10~
+  lpc10~ RESAMPLER_QUALITY CHANNELS
+
+  RESAMPLER_QUALITY: 0 (medium) [default], 1 (low latency), 2 (high)
+  CHANNELS: number of independent signals (default: 1)
 
 Inlets:
-  1x Audio inlet
+  CHANNELS x Audio inlet
   also bang: lose next frame (not implemented)
+  also latency: posts the latency (constant; prefill and resampler)
+  also worker 0/1: processes the frames on worker threads (adds one frame of latency; applied on the next DSP start)
+  also phase N: shifts the frame boundaries by N samples (internal sample rate; -1: automatic [default]; applied on the next DSP start)
 
 Outlets:
-  1x Audio outlet
+  CHANNELS x Audio outlet
+
+Developer note: the states of encoder and decoder are allocated once (lpc10_tilde_new()) and re-initialized in place on DSP start.
 
 */
 
@@ -36,60 +44,43 @@ typedef struct _lpc10_tilde {
 
   t_float float_inlet_unused;
 
-  struct lpc10_encoder_state *lpc10_encode_state;
-  struct lpc10_decoder_state *lpc10_decode_state;
+  struct lpc10_encoder_state *lpc10_encode_state;      //One per channel
+  struct lpc10_decoder_state *lpc10_decode_state;      //One per channel
 } t_lpc10_tilde;
 
 
-void lpc10_add_to_outbuffer (t_lpc10_tilde * x);
-
-t_int *lpc10_tilde_perform (t_int * w) {
-  t_lpc10_tilde *x = (t_lpc10_tilde *) (w[1]);
-  t_sample *in = (t_sample *) (w[2]);
-  t_sample *out = (t_sample *) (w[3]);
-  int n = (int) (w[4]);
-
-
-  generic_codec_resample_to_internal (&x->codec, n, in);
-  if (float_buffer_has_chunk (x->codec.ringbuffer_input)) {
-    lpc10_add_to_outbuffer (x);
-  }
-
-  if (float_buffer_has_chunk (x->codec.ringbuffer_output)) {
-    generic_codec_to_outbuffer (&x->codec, out);
-  }
-
-  return (w + 5);
+void lpc10_process_frames (t_lpc10_tilde * x, unsigned int channel, unsigned int n, float *frames) {
+  //All frames at once (contiguous)
+  INT32 compressed[n * LPC10_BITS_IN_COMPRESSED_FRAME];
+  lpc10_encode_frames (frames, compressed, n, &x->lpc10_encode_state[channel]);
+  lpc10_decode_frames (compressed, frames, n, &x->lpc10_decode_state[channel]);
 }
 
-void lpc10_add_to_outbuffer (t_lpc10_tilde * x) {
-  bool free_required = false;
-  float *frame;
-  float_buffer_pop_chunk (x->codec.ringbuffer_input, &frame, x->codec.ringbuffer_input->chunk_size, &free_required);
-
-  int compressed[LPC10_BITS_IN_COMPRESSED_FRAME];
-  lpc10_encode (frame, compressed, x->lpc10_encode_state);
-  lpc10_decode (compressed, frame, x->lpc10_decode_state);
+void lpc10_packet_loss (t_lpc10_tilde * x) {
+  error ("lpc10~: Packet-loss is not implemented.");
+}
 
-  generic_codec_resample_to_external (&x->codec, x->codec.ringbuffer_input->chunk_size, frame);
+void lpc10_latency (t_lpc10_tilde * x) {
+  generic_codec_post_latency (&x->codec, "lpc10~");
+}
 
-  if (free_required) {
-    free (frame);
-  }
+void lpc10_worker (t_lpc10_tilde * x, t_floatarg worker) {
+  generic_codec_set_worker (&x->codec, "lpc10~", worker != 0);
 }
 
-void lpc10_packet_loss (t_lpc10_tilde * x) {
-  x->codec.drop_next_frame = true;
-  error ("lpc10~: Packet-loss is not implemented.");
+void lpc10_phase (t_lpc10_tilde * x, t_floatarg phase) {
+  generic_codec_set_phase (&x->codec, "lpc10~", phase);
 }
 
 void lpc10_tilde_dsp (t_lpc10_tilde * x, t_signal ** sp) {
-  x->lpc10_encode_state = create_lpc10_encoder_state ();
-  init_lpc10_encoder_state (x->lpc10_encode_state);
-  x->lpc10_decode_state = create_lpc10_decoder_state ();
-  init_lpc10_decoder_state (x->lpc10_decode_state);
+  generic_codec_dsp_stop (&x->codec);
+
+  for (unsigned int channel = 0; channel < x->codec.channels; channel++) {
+    init_lpc10_encoder_state (&x->lpc10_encode_state[channel]);
+    init_lpc10_decoder_state (&x->lpc10_decode_state[channel]);
+  }
 
-  generic_codec_dsp_add (&x->codec, sp[0]->s_n, x, lpc10_tilde_perform, sp);
+  generic_codec_dsp_add (&x->codec, sp[0]->s_n, &x->codec, generic_codec_perform, sp);
 }
 
 void lpc10_tilde_free (t_lpc10_tilde * x) {
@@ -99,20 +90,36 @@ void lpc10_tilde_free (t_lpc10_tilde * x) {
   free (x->lpc10_decode_state);
 }
 
-void *lpc10_tilde_new () {
+void *lpc10_tilde_new (t_floatarg resampler_quality, t_floatarg channels) {
   t_lpc10_tilde *x = (t_lpc10_tilde *) pd_new (lpc10_tilde_class);
 
-  generic_codec_init (&x->codec, &x->x_obj, 8000, LPC10_SAMPLES_PER_FRAME);
+  if ((int) resampler_quality < 0 || (int) resampler_quality > 2) {
+    error ("lpc10~: invalid resampler quality specified (%d). Using 0 (medium).", (int) resampler_quality);
+    resampler_quality = RESAMPLER_QUALITY_MEDIUM;
+  }
+
+  if ((int) channels == 0) {
+    channels = 1;               //Default: mono
+  }
+  if ((int) channels < 1 || (int) channels > GENERIC_CODEC_CHANNELS_MAX) {
+    error ("lpc10~: invalid number of channels specified (%d). Using 1.", (int) channels);
+    channels = 1;
+  }
+
+  generic_codec_init (&x->codec, &x->x_obj, 8000, LPC10_SAMPLES_PER_FRAME, resampler_quality, channels, (t_generic_codec_process_frames) lpc10_process_frames);
 
-  x->lpc10_encode_state = NULL;
-  x->lpc10_decode_state = NULL;
+  x->lpc10_encode_state = malloc (channels * sizeof (struct lpc10_encoder_state));
+  x->lpc10_decode_state = malloc (channels * sizeof (struct lpc10_decoder_state));
 
   return (void *) x;
 }
 
 void lpc10_tilde_setup (void) {
-  lpc10_tilde_class = class_new (gensym ("lpc10~"), (t_newmethod) lpc10_tilde_new, (t_method) lpc10_tilde_free, sizeof (t_lpc10_tilde), CLASS_DEFAULT, 0);
+  lpc10_tilde_class = class_new (gensym ("lpc10~"), (t_newmethod) lpc10_tilde_new, (t_method) lpc10_tilde_free, sizeof (t_lpc10_tilde), CLASS_DEFAULT, A_DEFFLOAT, A_DEFFLOAT, 0);
   class_addmethod (lpc10_tilde_class, (t_method) lpc10_tilde_dsp, gensym ("dsp"), 0);
+  class_addmethod (lpc10_tilde_class, (t_method) lpc10_latency, gensym ("latency"), 0);
+  class_addmethod (lpc10_tilde_class, (t_method) lpc10_worker, gensym ("worker"), A_FLOAT, 0);
+  class_addmethod (lpc10_tilde_class, (t_method) lpc10_phase, gensym ("phase"), A_FLOAT, 0);
   class_addbang (lpc10_tilde_class, lpc10_packet_loss);
   CLASS_MAINSIGNALIN (lpc10_tilde_class, t_lpc10_tilde, float_inlet_unused);
   class_sethelpsymbol (lpc10_tilde_class, gensym ("lpc10~"));
@@ -7,13 +7,23 @@
 mnru~ applies noise simulated by the ITU-T's [Modulated Noise Reference Unit](https://en.wikipedia.org/wiki/Modulated_Noise_Reference_Unit) aka Schroedinger Noise (8 kHz).
 
 Parameters:
-  mnru~
+  mnru~ FRAME_SIZE Q RESAMPLER_QUALITY CHANNELS
+
+  FRAME_SIZE in samples: 80, 160
+  Q in dB
+  RESAMPLER_QUALITY: 0 (medium) [default], 1 (low latency), 2 (high)
+  CHANNELS: number of independent signals (default: 1)
 
 Inlets:
-  1x Audio inlet
+  CHANNELS x Audio inlet
+  also latency: posts the latency (constant; prefill and resampler)
+  also phase N: shifts the frame boundaries by N samples (internal sample rate; -1: automatic [default]; applied on the next DSP start)
 
 Outlets:
-  1x Audio outlet
+  CHANNELS x Audio outlet
+
+Developer note: the random number generators of the STL ignore the seed of MNRU_process() and keep a global state, i.e., all channels and instances draw the noise from one sequence.
+Developer note: worker mode is not supported, as the global state of the random number generators is not thread-safe.
 
 */
 
@@ -39,78 +49,66 @@ typedef struct _mnru_tilde {
   t_float float_inlet_unused;
 
   //MNRU parameters.
-  MNRU_state mnru_state;
+  MNRU_state *mnru_state;       //One per channel
   double mnru_qdb;
   char mnru_mode;
-  char mnru_operation;
+  char *mnru_operation;         //One per channel
 
 } t_mnru_tilde;
 
-void mnru_add_to_outbuffer (t_mnru_tilde * x);
+void mnru_process_frames (t_mnru_tilde * x, unsigned int channel, unsigned int n, float *frames) {
+  unsigned int frame_size = x->codec.frame_size;
 
-t_int *mnru_tilde_perform (t_int * w) {
-  t_mnru_tilde *x = (t_mnru_tilde *) (w[1]);
-  t_sample *in = (t_sample *) (w[2]);
-  t_sample *out = (t_sample *) (w[3]);
-  int n = (int) (w[4]);
-
-  generic_codec_resample_to_internal (&x->codec, n, in);
-  if (float_buffer_has_chunk (x->codec.ringbuffer_input)) {
-    mnru_add_to_outbuffer (x);
-  }
+  for (unsigned int f = 0; f < n; f++) {
+    float *frame = &frames[f * frame_size];
 
-  if (float_buffer_has_chunk (x->codec.ringbuffer_output)) {
-    generic_codec_to_outbuffer (&x->codec, out);
-  }
-
-  return (w + 5);
-}
+    float mnru_output[frame_size];
 
-void mnru_add_to_outbuffer (t_mnru_tilde * x) {
-  bool free_required = false;
-  float *frame;
-  float_buffer_pop_chunk (x->codec.ringbuffer_input, &frame, x->codec.ringbuffer_input->chunk_size, &free_required);
-
-  float mnru_output[x->codec.frame_size];
-
-  double *mnru_ok = MNRU_process (x->mnru_operation, &x->mnru_state, frame, mnru_output, (long) x->codec.frame_size, 314159265L, x->mnru_mode, x->mnru_qdb);
-  if (x->mnru_operation == MNRU_START) {
-    x->mnru_operation = MNRU_CONTINUE;
-  }
-
-  if (mnru_ok == NULL) {
-    error ("mnru~: MǸRU process reported an error; applying zero insertion.");
-    for (int i = 0; i < x->codec.frame_size; i++) {
-      mnru_output[i] = 0;
+    double *mnru_ok = MNRU_process (x->mnru_operation[channel], &x->mnru_state[channel], frame, mnru_output, (long) frame_size, 314159265L, x->mnru_mode, x->mnru_qdb);
+    if (x->mnru_operation[channel] == MNRU_START) {
+      x->mnru_operation[channel] = MNRU_CONTINUE;
     }
-  }
 
-  generic_codec_resample_to_external (&x->codec, x->codec.frame_size, mnru_output);
+    if (mnru_ok == NULL) {
+      generic_codec_error (&x->codec, "mnru~: MǸRU process reported an error; applying zero insertion.");
+      for (unsigned int i = 0; i < frame_size; i++) {
+        mnru_output[i] = 0;
+      }
+    }
 
-  if (free_required) {
-    free (frame);
+    memcpy (frame, mnru_output, frame_size * sizeof (float));
   }
 }
 
 void mnru_packet_loss (t_mnru_tilde * x) {
-  x->codec.drop_next_frame = true;
+  generic_codec_drop_next_frame (&x->codec);
   error ("mnru~: Packet-loss is not implemented.");
 }
 
-void mnru_tilde_dsp (t_mnru_tilde * x, t_signal ** sp) {
-  MNRU_state mnru_state;
-  x->mnru_state = mnru_state;
+void mnru_latency (t_mnru_tilde * x) {
+  generic_codec_post_latency (&x->codec, "mnru~");
+}
 
-  x->mnru_operation = MNRU_START;
+void mnru_phase (t_mnru_tilde * x, t_floatarg phase) {
+  generic_codec_set_phase (&x->codec, "mnru~", phase);
+}
 
-  generic_codec_dsp_add (&x->codec, sp[0]->s_n, x, mnru_tilde_perform, sp);
+void mnru_tilde_dsp (t_mnru_tilde * x, t_signal ** sp) {
+  for (unsigned int channel = 0; channel < x->codec.channels; channel++) {
+    x->mnru_operation[channel] = MNRU_START;
+  }
+
+  generic_codec_dsp_add (&x->codec, sp[0]->s_n, &x->codec, generic_codec_perform, sp);
 }
 
 void mnru_tilde_free (t_mnru_tilde * x) {
   generic_codec_free (&x->codec);
+
+  free (x->mnru_state);
+  free (x->mnru_operation);
 }
 
-void *mnru_tilde_new (t_floatarg frame_size, t_floatarg mnru_qdb) {
+void *mnru_tilde_new (t_floatarg frame_size, t_floatarg mnru_qdb, t_floatarg resampler_quality, t_floatarg channels) {
   t_mnru_tilde *x = (t_mnru_tilde *) pd_new (mnru_tilde_class);
 
   if ((int) frame_size != 80 && frame_size != 160) {
@@ -121,14 +119,32 @@ void *mnru_tilde_new (t_floatarg frame_size, t_floatarg mnru_qdb) {
   x->mnru_mode = MOD_NOISE;
   x->mnru_qdb = mnru_qdb;
 
-  generic_codec_init (&x->codec, &x->x_obj, 8000, frame_size);
+  if ((int) resampler_quality < 0 || (int) resampler_quality > 2) {
+    error ("mnru~: invalid resampler quality specified (%d). Using 0 (medium).", (int) resampler_quality);
+    resampler_quality = RESAMPLER_QUALITY_MEDIUM;
+  }
+
+  if ((int) channels == 0) {
+    channels = 1;               //Default: mono
+  }
+  if ((int) channels < 1 || (int) channels > GENERIC_CODEC_CHANNELS_MAX) {
+    error ("mnru~: invalid number of channels specified (%d). Using 1.", (int) channels);
+    channels = 1;
+  }
+
+  generic_codec_init (&x->codec, &x->x_obj, 8000, frame_size, resampler_quality, channels, (t_generic_codec_process_frames) mnru_process_frames);
+
+  x->mnru_state = calloc (channels, sizeof (MNRU_state));
+  x->mnru_operation = calloc (channels, sizeof (char));
 
   post ("mnru~: Created with Q in db (%f) and block size (%d).", x->mnru_qdb, x->codec.frame_size);
   return (void *) x;
 }
 void mnru_tilde_setup (void) {
-  mnru_tilde_class = class_new (gensym ("mnru~"), (t_newmethod) mnru_tilde_new, (t_method) mnru_tilde_free, sizeof (t_mnru_tilde), CLASS_DEFAULT, A_DEFFLOAT, A_DEFFLOAT, 0);
+  mnru_tilde_class = class_new (gensym ("mnru~"), (t_newmethod) mnru_tilde_new, (t_method) mnru_tilde_free, sizeof (t_mnru_tilde), CLASS_DEFAULT, A_DEFFLOAT, A_DEFFLOAT, A_DEFFLOAT, A_DEFFLOAT, 0);
   class_addmethod (mnru_tilde_class, (t_method) mnru_tilde_dsp, gensym ("dsp"), 0);
+  class_addmethod (mnru_tilde_class, (t_method) mnru_latency, gensym ("latency"), 0);
+  class_addmethod (mnru_tilde_class, (t_method) mnru_phase, gensym ("phase"), A_FLOAT, 0);
   CLASS_MAINSIGNALIN (mnru_tilde_class, t_mnru_tilde, float_inlet_unused);
   class_sethelpsymbol (mnru_tilde_class, gensym ("mnru~"));
 }
@@ -7,14 +7,38 @@
 opus~ encodes the signal with [OPUS](https://en.wikipedia.org/wiki/Opus_(audio_format)).
 
 Parameters:
-  opus~
+  opus~ FRAME_SIZE FORWARD_ERROR_CORRECTION SAMPLE_RATE RESAMPLER_QUALITY CHANNELS MULTISTREAM
+
+  FRAME_SIZE in samples: 80, 160, 240
+  FORWARD_ERROR_CORRECTION: 0 (off) [default], 1 (on; lost frames are reconstructed from the in-band FEC of the next packet; adds one frame of latency)
+  SAMPLE_RATE in Hz: 8000 [default], 12000, 16000, 24000, 48000
+  RESAMPLER_QUALITY: 0 (medium) [default], 1 (low latency), 2 (high)
+  CHANNELS: number of signals (default: 1)
+  MULTISTREAM: 0 (one encoder per channel, i.e., independent signals) [default], 1 (all channels are coded by one multistream encoder; pairs of channels are coupled, e.g., stereo)
 
 Inlets:
-  1x Audio inlet
+  CHANNELS x Audio inlet
   also bang: lose next frame
+  also latency: posts the latency (constant; prefill, resampler and FEC holdback)
+  also worker 0/1: processes the frames on worker threads (adds one frame of latency; applied on the next DSP start)
+  also phase N: shifts the frame boundaries by N samples (internal sample rate; -1: automatic [default]; applied on the next DSP start)
+  also bitrate N: bitrate in bit/s (500 to 512000 per channel; multistream: total of all channels; 0: automatic [default])
+  also complexity N: 0 (lowest CPU load) to 10 (best quality) (default: default of libopus)
+  also vbr 0/1: constant (0) or variable (1) [default] bitrate
+  also dtx 0/1: discontinuous transmission (default: 0)
+  also bandwidth N: audio bandwidth in Hz: 4000, 6000, 8000, 12000, 20000 (0: automatic [default])
+  also loss_percentage N: expected packet loss in percent (0 to 100; default: 0); the encoder adds redundancy for in-band FEC accordingly
+  also fec 0/1: in-band forward error correction (FEC holdback applied on the next DSP start)
+
+Developer note: the settings are applied to the encoders before the next frames are processed (generic_codec_request_settings()), i.e., also in worker mode.
+Developer note: in-band FEC is only added by the encoder if the expected packet loss is larger than 0.
+Developer note: coder: one encoder and decoder; one per channel or one multistream coder for all channels.
+Developer note: the coders are allocated once in one block (opus_encoder_get_size()) and reset on DSP start (OPUS_RESET_STATE).
+Developer note: FEC holdback: the decoder is one packet behind the encoder; a lost packet is decoded from the FEC data of the next packet (decode_fec = 1) or by PLC if the next packet is also lost.
+Developer note: multistream: all channels are coded when process_frames is called for channel 0 (frames of channel i start at codec.frames[i * codec.frames_max * codec.frame_size]); channel i is mapped to channel i of the streams (coupled streams first).
 
 Outlets:
-  1x Audio outlet
+  CHANNELS x Audio outlet
 
 */
 
@@ -26,110 +50,448 @@ Outlets:
 #include "generic_codec.h"
 
 #include <opus/opus.h>
+#include <opus/opus_multistream.h>
+
+#define OPUS_TILDE_PACKET_MAX 1275 //Bytes (per stream)
+#define OPUS_TILDE_ALIGNMENT 16 //Bytes; encoders and decoders in one block
 
 static t_class *opus_tilde_class;
 
+typedef struct _opus_settings {
+  int bitrate;                  //bit/s or OPUS_AUTO
+  int complexity;               //0 to 10; -1: default of libopus
+  int vbr;
+  int dtx;
+  int bandwidth;                //OPUS_BANDWIDTH_* or OPUS_AUTO
+  int packet_loss_percentage;
+  int forward_error_correction;
+} t_opus_settings;
+
+//Packet held back for FEC (one per coder).
+typedef struct _opus_holdback {
+  unsigned char *packet;        //packet_max bytes
+  int length;
+  bool held;                    //A packet is held (false on DSP start)
+  bool lost;
+} t_opus_holdback;
+
 typedef struct _opus_tilde {
   t_object x_obj;
 
   t_generic_codec codec;
 
-  OpusEncoder *encoder;
+  bool multistream;
+  unsigned int coders;          //Number of coders (multistream: 1)
+  unsigned int coder_channels;  //Channels per coder (multistream: all)
+
+  OpusEncoder **encoder;        //One per channel (not multistream; NULL otherwise)
+  OpusDecoder **decoder;        //One per channel (not multistream; NULL otherwise)
 
-  OpusDecoder *decoder;
+  OpusMSEncoder *multistream_encoder;
+  OpusMSDecoder *multistream_decoder;
+  float *interleaved;           //Multistream: one frame of all channels (interleaved)
+
+  void *arena;                  //Encoders and decoders of all coders
+  unsigned int packet_max;      //Bytes
 
   int opus_error;
 
-  int forward_error_correction;
+  t_opus_settings settings;     //Requested by methods; applied to all encoders (opus_apply_settings())
+
+  bool fec_holdback;            //Decoding uses the FEC holdback (set on DSP start)
+  t_opus_holdback *holdback;    //One per coder
 
   t_float float_inlet_unused;
 } t_opus_tilde;
 
-void opus_add_to_outbuffer (t_opus_tilde * x);
+//Encodes one frame (coder_channels x frame_size; interleaved) (helper function).
+int opus_tilde_encode (t_opus_tilde * x, unsigned int coder, const float *pcm, unsigned char *compressed) {
+  if (x->multistream) {
+    return opus_multistream_encode_float (x->multistream_encoder, pcm, x->codec.frame_size, compressed, x->packet_max);
+  }
+  return opus_encode_float (x->encoder[coder], pcm, x->codec.frame_size, compressed, x->packet_max);
+}
 
-t_int *opus_tilde_perform (t_int * w) {
-  t_opus_tilde *x = (t_opus_tilde *) (w[1]);
-  t_sample *in = (t_sample *) (w[2]);
-  t_sample *out = (t_sample *) (w[3]);
-  int n = (int) (w[4]);
+//Decodes one frame (coder_channels x frame_size; interleaved); compressed NULL: PLC (helper function).
+int opus_tilde_decode (t_opus_tilde * x, unsigned int coder, const unsigned char *compressed, int compressed_length, float *pcm, int decode_fec) {
+  if (x->multistream) {
+    return opus_multistream_decode_float (x->multistream_decoder, compressed, compressed_length, pcm, x->codec.frame_size, decode_fec);
+  }
+  return opus_decode_float (x->decoder[coder], compressed, compressed_length, pcm, x->codec.frame_size, decode_fec);
+}
 
-  generic_codec_resample_to_internal (&x->codec, n, in);
+//Decodes the held packet (previous frame) and holds the current packet (compressed_length 0: lost); a lost packet is reconstructed from the FEC data of the next packet (helper function).
+int opus_decode_holdback (t_opus_tilde * x, unsigned int coder, const unsigned char *compressed, int compressed_length, float *pcm) {
+  t_opus_holdback *holdback = &x->holdback[coder];
 
-  if (float_buffer_has_chunk (x->codec.ringbuffer_input)) {
-    opus_add_to_outbuffer (x);
+  int decompressed_length = x->codec.frame_size;
+  if (!holdback->held) {
+    memset (pcm, 0, x->coder_channels * x->codec.frame_size * sizeof (float));
+  } else if (!holdback->lost) {
+    decompressed_length = opus_tilde_decode (x, coder, holdback->packet, holdback->length, pcm, 0);
+  } else if (compressed_length > 0) {
+    decompressed_length = opus_tilde_decode (x, coder, compressed, compressed_length, pcm, 1);
+  } else {
+    decompressed_length = opus_tilde_decode (x, coder, NULL, 0, pcm, 0);
   }
 
-  if (float_buffer_has_chunk (x->codec.ringbuffer_output)) {
-    generic_codec_to_outbuffer (&x->codec, out);
+  memcpy (holdback->packet, compressed, compressed_length);
+  holdback->length = compressed_length;
+  holdback->lost = compressed_length == 0;
+  holdback->held = true;
+  return decompressed_length;
+}
+
+void opus_process_frames (t_opus_tilde * x, unsigned int channel, unsigned int n, float *frames) {
+  if (x->multistream && channel > 0) {
+    return;                     //Coded with channel 0
+  }
+  unsigned int frame_size = x->codec.frame_size;
+  unsigned int stride = x->codec.frames_max * frame_size;       //Distance of the frames of two channels
+
+  for (unsigned int f = 0; f < n; f++) {
+    float *frame = &frames[f * frame_size];
+
+    float *pcm = frame;
+    if (x->multistream) {
+      pcm = x->interleaved;
+      for (unsigned int c = 0; c < x->coder_channels; c++) {
+        for (unsigned int i = 0; i < frame_size; i++) {
+          pcm[i * x->coder_channels + c] = frame[c * stride + i];
+        }
+      }
+    }
+
+    unsigned char compressed[x->packet_max];
+    int compressed_length = opus_tilde_encode (x, channel, pcm, compressed);
+
+    bool lost = x->codec.drop_next_frame[channel];
+    for (unsigned int c = 0; c < x->coder_channels; c++) {
+      x->codec.drop_next_frame[channel + c] = false;
+    }
+
+    if (compressed_length < 0) {
+      generic_codec_error (&x->codec, "opus~: Compressing current frame failed with error code %d.", compressed_length);
+      lost = true;
+    }
+
+    int decompressed_length;
+    if (x->fec_holdback) {
+      decompressed_length = opus_decode_holdback (x, channel, compressed, lost ? 0 : compressed_length, pcm);
+    } else if (lost) {
+      decompressed_length = opus_tilde_decode (x, channel, NULL, 0, pcm, 0);
+    } else {
+      decompressed_length = opus_tilde_decode (x, channel, compressed, compressed_length, pcm, 0);
+    }
+
+    if (decompressed_length < 0) {
+      generic_codec_error (&x->codec, "opus~: Decompressing current frame failed with error code %d.", decompressed_length);
+      memset (pcm, 0, x->coder_channels * frame_size * sizeof (float));
+    }
+
+    if (x->multistream) {
+      for (unsigned int c = 0; c < x->coder_channels; c++) {
+        for (unsigned int i = 0; i < frame_size; i++) {
+          frame[c * stride + i] = pcm[i * x->coder_channels + c];
+        }
+      }
+    }
   }
+}
+
+void opus_packet_loss (t_opus_tilde * x) {
+  generic_codec_drop_next_frame (&x->codec);
+}
 
-  return (w + 5);
+void opus_latency (t_opus_tilde * x) {
+  generic_codec_post_latency (&x->codec, "opus~");
 }
 
-void opus_add_to_outbuffer (t_opus_tilde * x) {
-  bool free_required = false;
-  float *frame;
-  float_buffer_pop_chunk (x->codec.ringbuffer_input, &frame, x->codec.ringbuffer_input->chunk_size, &free_required);
+void opus_worker (t_opus_tilde * x, t_floatarg worker) {
+  generic_codec_set_worker (&x->codec, "opus~", worker != 0);
+}
 
-  int decompressed_length = x->codec.frame_size;
-  unsigned char compressed[x->codec.frame_size];        //Assuming coding requires less space
-  int compressed_length = opus_encode_float (x->encoder, frame, x->codec.frame_size, compressed, x->codec.ringbuffer_input->chunk_size);
-  if (compressed_length < 0) {
-    error ("opus~: Compressing current frame failed with error code %d.", compressed_length);
+void opus_phase (t_opus_tilde * x, t_floatarg phase) {
+  generic_codec_set_phase (&x->codec, "opus~", phase);
+}
+
+//Sets one option (request and value) of the encoder of a coder (helper function).
+int opus_tilde_encoder_ctl (t_opus_tilde * x, unsigned int coder, int request, opus_int32 value) {
+  if (x->multistream) {
+    return opus_multistream_encoder_ctl (x->multistream_encoder, request, value);
+  }
+  return opus_encoder_ctl (x->encoder[coder], request, value);
+}
+
+//Configures the encoder of a coder with the settings; returns OPUS_OK or the first error (helper function).
+int opus_tilde_configure (t_opus_tilde * x, unsigned int coder) {
+  const t_opus_settings *settings = &x->settings;
+  int opus_error = opus_tilde_encoder_ctl (x, coder, OPUS_SET_BITRATE (settings->bitrate));
+  if (opus_error == OPUS_OK && settings->complexity >= 0) {
+    opus_error = opus_tilde_encoder_ctl (x, coder, OPUS_SET_COMPLEXITY (settings->complexity));
+  }
+  if (opus_error == OPUS_OK) {
+    opus_error = opus_tilde_encoder_ctl (x, coder, OPUS_SET_VBR (settings->vbr));
+  }
+  if (opus_error == OPUS_OK) {
+    opus_error = opus_tilde_encoder_ctl (x, coder, OPUS_SET_DTX (settings->dtx));
+  }
+  if (opus_error == OPUS_OK) {
+    opus_error = opus_tilde_encoder_ctl (x, coder, OPUS_SET_BANDWIDTH (settings->bandwidth));
+  }
+  if (opus_error == OPUS_OK) {
+    opus_error = opus_tilde_encoder_ctl (x, coder, OPUS_SET_PACKET_LOSS_PERC (settings->packet_loss_percentage));
+  }
+  if (opus_error == OPUS_OK) {
+    opus_error = opus_tilde_encoder_ctl (x, coder, OPUS_SET_INBAND_FEC (settings->forward_error_correction));
+  }
+  return opus_error;
+}
+
+//Applies the settings to the encoders of all coders (DSP-thread; callback of generic_codec).
+void opus_apply_settings (t_opus_tilde * x) {
+  if (x->arena == NULL) {
     return;
   }
+  for (unsigned int coder = 0; coder < x->coders; coder++) {
+    int opus_error = opus_tilde_configure (x, coder);
+    if (opus_error != OPUS_OK) {
+      generic_codec_error (&x->codec, "opus~: Applying the settings failed with error code %d.", opus_error);
+    }
+  }
+}
 
-  if (x->codec.drop_next_frame) {
-    decompressed_length = opus_decode_float (x->decoder, NULL, 0, frame, x->codec.frame_size, x->forward_error_correction);
-    x->codec.drop_next_frame = false;
-  } else {
-    decompressed_length = opus_decode_float (x->decoder, compressed, compressed_length, frame, x->codec.frame_size, x->forward_error_correction);
+//Posts a hint if in-band FEC is enabled, but not used by the encoder (helper function).
+void opus_check_forward_error_correction (t_opus_tilde * x) {
+  if (x->settings.forward_error_correction && x->settings.packet_loss_percentage == 0) {
+    post ("opus~: in-band forward error correction is only added for an expected packet loss (loss_percentage) larger than 0.");
   }
+}
 
-  generic_codec_resample_to_external (&x->codec, x->codec.ringbuffer_input->chunk_size, frame);
+void opus_bitrate (t_opus_tilde * x, t_floatarg bitrate) {
+  if ((int) bitrate != 0 && ((int) bitrate < 500 || (int) bitrate > 512000 * (int) x->coder_channels)) {
+    error ("opus~: invalid bitrate specified (%d). Using 0 (automatic).", (int) bitrate);
+    bitrate = 0;
+  }
+  x->settings.bitrate = (int) bitrate == 0 ? OPUS_AUTO : (int) bitrate;
+  generic_codec_request_settings (&x->codec);
+}
 
-  if (free_required) {
-    free (frame);
+void opus_complexity (t_opus_tilde * x, t_floatarg complexity) {
+  if ((int) complexity < 0 || (int) complexity > 10) {
+    error ("opus~: invalid complexity specified (%d). Using 10.", (int) complexity);
+    complexity = 10;
   }
+  x->settings.complexity = complexity;
+  generic_codec_request_settings (&x->codec);
 }
 
-void opus_packet_loss (t_opus_tilde * x) {
-  x->codec.drop_next_frame = true;
+void opus_vbr (t_opus_tilde * x, t_floatarg vbr) {
+  x->settings.vbr = vbr != 0;
+  generic_codec_request_settings (&x->codec);
 }
 
-void opus_tilde_dsp (t_opus_tilde * x, t_signal ** sp) {
-  int opus_error;
-  x->encoder = opus_encoder_create (x->codec.sample_rate_internal, 1, OPUS_APPLICATION_VOIP, &opus_error);
-  if (opus_error != OPUS_OK) {
-    error ("opus~: Initializing OPUS encoder failed.");
-    return;
+void opus_dtx (t_opus_tilde * x, t_floatarg dtx) {
+  x->settings.dtx = dtx != 0;
+  generic_codec_request_settings (&x->codec);
+}
+
+void opus_bandwidth (t_opus_tilde * x, t_floatarg bandwidth) {
+  switch ((int) bandwidth) {
+    case 0:
+      x->settings.bandwidth = OPUS_AUTO;
+      break;
+    case 4000:
+      x->settings.bandwidth = OPUS_BANDWIDTH_NARROWBAND;
+      break;
+    case 6000:
+      x->settings.bandwidth = OPUS_BANDWIDTH_MEDIUMBAND;
+      break;
+    case 8000:
+      x->settings.bandwidth = OPUS_BANDWIDTH_WIDEBAND;
+      break;
+    case 12000:
+      x->settings.bandwidth = OPUS_BANDWIDTH_SUPERWIDEBAND;
+      break;
+    case 20000:
+      x->settings.bandwidth = OPUS_BANDWIDTH_FULLBAND;
+      break;
+    default:
+      error ("opus~: invalid bandwidth specified (%d). Using 0 (automatic).", (int) bandwidth);
+      x->settings.bandwidth = OPUS_AUTO;
+  }
+  generic_codec_request_settings (&x->codec);
+}
+
+void opus_loss_percentage (t_opus_tilde * x, t_floatarg packet_loss_percentage) {
+  if ((int) packet_loss_percentage < 0 || (int) packet_loss_percentage > 100) {
+    error ("opus~: invalid packet loss percentage specified (%d). Using 0.", (int) packet_loss_percentage);
+    packet_loss_percentage = 0;
   }
+  x->settings.packet_loss_percentage = packet_loss_percentage;
+  generic_codec_request_settings (&x->codec);
+  opus_check_forward_error_correction (x);
+}
 
-  x->decoder = opus_decoder_create (x->codec.sample_rate_internal, 1, &opus_error);
-  if (opus_error != OPUS_OK) {
-    error ("opus~: Initializing OPUS decoder failed.");
+//The FEC holdback is applied on the next DSP start (the latency changes).
+void opus_fec (t_opus_tilde * x, t_floatarg forward_error_correction) {
+  if (x->settings.forward_error_correction == (forward_error_correction != 0)) {
     return;
   }
+  x->settings.forward_error_correction = forward_error_correction != 0;
+  post ("opus~: forward error correction %s (FEC holdback applied on the next DSP start).", x->settings.forward_error_correction ? "enabled" : "disabled");
+  opus_check_forward_error_correction (x);
+  generic_codec_request_settings (&x->codec);
+}
 
-  generic_codec_dsp_add (&x->codec, sp[0]->s_n, x, opus_tilde_perform, sp);
+//Rounds size up to OPUS_TILDE_ALIGNMENT (helper function).
+static size_t opus_tilde_align (size_t size) {
+  return (size + OPUS_TILDE_ALIGNMENT - 1) / OPUS_TILDE_ALIGNMENT * OPUS_TILDE_ALIGNMENT;
 }
 
-void opus_tilde_free (t_opus_tilde * x) {
-  generic_codec_free (&x->codec);
+//Frees the coders and the buffers of opus_tilde_alloc_codec() (helper function).
+void opus_tilde_free_codec (t_opus_tilde * x) {
+  if (x->holdback != NULL) {
+    for (unsigned int coder = 0; coder < x->coders; coder++) {
+      free (x->holdback[coder].packet);
+    }
+  }
+  free (x->holdback);
+  x->holdback = NULL;
+  free (x->arena);
+  x->arena = NULL;
+  free (x->encoder);
+  x->encoder = NULL;
+  free (x->decoder);
+  x->decoder = NULL;
+  free (x->interleaved);
+  x->interleaved = NULL;
+}
+
+//Allocates the buffers and initializes the encoders and decoders of all coders in one block; returns false on failure (helper function).
+bool opus_tilde_alloc_codec (t_opus_tilde * x) {
+  //Multistream: pairs of channels are coupled; channel i is mapped to channel i of the streams
+  int coupled_streams = x->codec.channels / 2;
+  int streams = x->codec.channels - coupled_streams;
+  unsigned char mapping[GENERIC_CODEC_CHANNELS_MAX];
+  for (unsigned int channel = 0; channel < x->codec.channels; channel++) {
+    mapping[channel] = channel;
+  }
+  x->packet_max = (x->multistream ? streams : 1) * OPUS_TILDE_PACKET_MAX;
+
+  x->holdback = calloc (x->coders, sizeof (t_opus_holdback));
+  if (x->holdback == NULL) {
+    error ("opus~: Allocating memory failed.");
+    return false;
+  }
+  for (unsigned int coder = 0; coder < x->coders; coder++) {
+    x->holdback[coder].packet = malloc (x->packet_max);
+    if (x->holdback[coder].packet == NULL) {
+      error ("opus~: Allocating memory failed.");
+      return false;
+    }
+  }
+
+  if (x->multistream) {
+    x->interleaved = calloc (x->codec.channels * x->codec.frame_size, sizeof (float));
+  } else {
+    x->encoder = calloc (x->codec.channels, sizeof (OpusEncoder *));
+    x->decoder = calloc (x->codec.channels, sizeof (OpusDecoder *));
+  }
+  if (x->multistream ? x->interleaved == NULL : (x->encoder == NULL || x->decoder == NULL)) {
+    error ("opus~: Allocating memory failed.");
+    return false;
+  }
+
+  size_t encoder_size = opus_tilde_align (x->multistream ? opus_multistream_encoder_get_size (streams, coupled_streams) : opus_encoder_get_size (1));
+  size_t decoder_size = opus_tilde_align (x->multistream ? opus_multistream_decoder_get_size (streams, coupled_streams) : opus_decoder_get_size (1));
+  x->arena = malloc (x->coders * (encoder_size + decoder_size));
+  if (x->arena == NULL) {
+    error ("opus~: Allocating OPUS encoder and decoder failed.");
+    return false;
+  }
+
+  if (x->multistream) {
+    x->multistream_encoder = (OpusMSEncoder *) x->arena;
+    x->multistream_decoder = (OpusMSDecoder *) ((char *) x->arena + encoder_size);
+
+    if (opus_multistream_encoder_init (x->multistream_encoder, x->codec.sample_rate_internal, x->codec.channels, streams, coupled_streams, mapping, OPUS_APPLICATION_VOIP) != OPUS_OK) {
+      error ("opus~: Initializing OPUS multistream encoder failed.");
+      return false;
+    }
+    if (opus_multistream_decoder_init (x->multistream_decoder, x->codec.sample_rate_internal, x->codec.channels, streams, coupled_streams, mapping) != OPUS_OK) {
+      error ("opus~: Initializing OPUS multistream decoder failed.");
+      return false;
+    }
+    return true;
+  }
+
+  char *block = x->arena;
+  for (unsigned int channel = 0; channel < x->codec.channels; channel++) {
+    x->encoder[channel] = (OpusEncoder *) block;
+    block += encoder_size;
+    x->decoder[channel] = (OpusDecoder *) block;
+    block += decoder_size;
+
+    if (opus_encoder_init (x->encoder[channel], x->codec.sample_rate_internal, 1, OPUS_APPLICATION_VOIP) != OPUS_OK) {
+      error ("opus~: Initializing OPUS encoder failed.");
+      return false;
+    }
+    if (opus_decoder_init (x->decoder[channel], x->codec.sample_rate_internal, 1) != OPUS_OK) {
+      error ("opus~: Initializing OPUS decoder failed.");
+      return false;
+    }
+  }
+  return true;
+}
 
-  if (x->encoder != NULL) {
-    opus_encoder_destroy (x->encoder);
-    x->encoder = NULL;
+//Resets the encoders and decoders (allocation-free).
+void opus_tilde_dsp (t_opus_tilde * x, t_signal ** sp) {
+  if (x->arena == NULL) {
+    error ("opus~: OPUS encoder and decoder are not available.");
+    return;
   }
-  if (x->decoder != NULL) {
-    opus_decoder_destroy (x->decoder);
-    x->decoder = NULL;
+  generic_codec_dsp_stop (&x->codec);
+
+  for (unsigned int coder = 0; coder < x->coders; coder++) {
+    if (x->multistream) {
+      opus_multistream_encoder_ctl (x->multistream_encoder, OPUS_RESET_STATE);
+      opus_multistream_decoder_ctl (x->multistream_decoder, OPUS_RESET_STATE);
+    } else {
+      opus_encoder_ctl (x->encoder[coder], OPUS_RESET_STATE);
+      opus_decoder_ctl (x->decoder[coder], OPUS_RESET_STATE);
+    }
+
+    int opus_error = opus_tilde_configure (x, coder);
+    if (opus_error != OPUS_OK) {
+      error ("opus~: Applying the settings failed with error code %d.", opus_error);
+    }
+
+    x->holdback[coder].held = false;
   }
+
+  x->fec_holdback = x->settings.forward_error_correction;
+  x->codec.delay = x->fec_holdback ? x->codec.frame_size : 0;
+
+  generic_codec_dsp_add (&x->codec, sp[0]->s_n, &x->codec, generic_codec_perform, sp);
+}
+
+void opus_tilde_free (t_opus_tilde * x) {
+  generic_codec_free (&x->codec);
+  opus_tilde_free_codec (x);
 }
 
-void *opus_tilde_new (t_floatarg frame_size, t_floatarg forward_error_correction, t_floatarg sample_rate) {
+void *opus_tilde_new (t_symbol * s, int argc, t_atom * argv) {
+  (void) s;
   t_opus_tilde *x = (t_opus_tilde *) pd_new (opus_tilde_class);
 
+  t_float frame_size = atom_getfloatarg (0, argc, argv);
+  t_float forward_error_correction = atom_getfloatarg (1, argc, argv);
+  t_float sample_rate = atom_getfloatarg (2, argc, argv);
+  t_float resampler_quality = atom_getfloatarg (3, argc, argv);
+  t_float channels = atom_getfloatarg (4, argc, argv);
+  t_float multistream = atom_getfloatarg (5, argc, argv);
+
   if ((int) frame_size != 80 && (int) frame_size != 160 && (int) frame_size != 240) {
     error ("opus~: invalid frame size specified (%d). Using 80.", (int) frame_size);
     frame_size = 80;
@@ -144,18 +506,63 @@ void *opus_tilde_new (t_floatarg frame_size, t_floatarg forward_error_correction
     error ("opus~: invalid forward error correction specified (%d). Using 0 (none).", (int) forward_error_correction);
     forward_error_correction = 0;
   }
-  x->forward_error_correction = forward_error_correction;
 
-  generic_codec_init (&x->codec, &x->x_obj, sample_rate, frame_size);
+  x->settings.bitrate = OPUS_AUTO;
+  x->settings.complexity = -1;
+  x->settings.vbr = 1;
+  x->settings.dtx = 0;
+  x->settings.bandwidth = OPUS_AUTO;
+  x->settings.packet_loss_percentage = 0;
+  x->settings.forward_error_correction = forward_error_correction;
+
+  if ((int) resampler_quality < 0 || (int) resampler_quality > 2) {
+    error ("opus~: invalid resampler quality specified (%d). Using 0 (medium).", (int) resampler_quality);
+    resampler_quality = RESAMPLER_QUALITY_MEDIUM;
+  }
+
+  if ((int) channels == 0) {
+    channels = 1;               //Default: mono
+  }
+  if ((int) channels < 1 || (int) channels > GENERIC_CODEC_CHANNELS_MAX) {
+    error ("opus~: invalid number of channels specified (%d). Using 1.", (int) channels);
+    channels = 1;
+  }
+
+  if ((int) multistream != 0 && (int) multistream != 1) {
+    error ("opus~: invalid multistream specified (%d). Using 0 (one encoder per channel).", (int) multistream);
+    multistream = 0;
+  }
+
+  generic_codec_init (&x->codec, &x->x_obj, sample_rate, frame_size, resampler_quality, channels, (t_generic_codec_process_frames) opus_process_frames);
+  x->codec.apply_settings = (t_generic_codec_apply_settings) opus_apply_settings;
+
+  x->multistream = multistream;
+  x->coders = x->multistream ? 1 : x->codec.channels;
+  x->coder_channels = x->multistream ? x->codec.channels : 1;
+
+  if (!opus_tilde_alloc_codec (x)) {
+    opus_tilde_free_codec (x);  //Not available (arena is NULL)
+  }
 
-  post ("opus~: Created with frame size (%d), forward_error_correction (%d), and sample rate (%f).", x->codec.frame_size, x->forward_error_correction, sample_rate);
+  post ("opus~: Created with frame size (%d), forward_error_correction (%d), sample rate (%f), channels (%d), and multistream (%d).", x->codec.frame_size, x->settings.forward_error_correction, sample_rate, x->codec.channels, x->multistream);
+  opus_check_forward_error_correction (x);
 
   return (void *) x;
 }
 
 void opus_tilde_setup (void) {
-  opus_tilde_class = class_new (gensym ("opus~"), (t_newmethod) opus_tilde_new, (t_method) opus_tilde_free, sizeof (t_opus_tilde), CLASS_DEFAULT, A_DEFFLOAT, A_DEFFLOAT, A_DEFFLOAT, A_DEFFLOAT, 0);
+  opus_tilde_class = class_new (gensym ("opus~"), (t_newmethod) opus_tilde_new, (t_method) opus_tilde_free, sizeof (t_opus_tilde), CLASS_DEFAULT, A_GIMME, 0);
   class_addmethod (opus_tilde_class, (t_method) opus_tilde_dsp, gensym ("dsp"), 0);
+  class_addmethod (opus_tilde_class, (t_method) opus_latency, gensym ("latency"), 0);
+  class_addmethod (opus_tilde_class, (t_method) opus_worker, gensym ("worker"), A_FLOAT, 0);
+  class_addmethod (opus_tilde_class, (t_method) opus_phase, gensym ("phase"), A_FLOAT, 0);
+  class_addmethod (opus_tilde_class, (t_method) opus_bitrate, gensym ("bitrate"), A_FLOAT, 0);
+  class_addmethod (opus_tilde_class, (t_method) opus_complexity, gensym ("complexity"), A_FLOAT, 0);
+  class_addmethod (opus_tilde_class, (t_method) opus_vbr, gensym ("vbr"), A_FLOAT, 0);
+  class_addmethod (opus_tilde_class, (t_method) opus_dtx, gensym ("dtx"), A_FLOAT, 0);
+  class_addmethod (opus_tilde_class, (t_method) opus_bandwidth, gensym ("bandwidth"), A_FLOAT, 0);
+  class_addmethod (opus_tilde_class, (t_method) opus_loss_percentage, gensym ("loss_percentage"), A_FLOAT, 0);
+  class_addmethod (opus_tilde_class, (t_method) opus_fec, gensym ("fec"), A_FLOAT, 0);
   class_addbang (opus_tilde_class, opus_packet_loss);
   CLASS_MAINSIGNALIN (opus_tilde_class, t_opus_tilde, float_inlet_unused);
   class_sethelpsymbol (opus_tilde_class, gensym ("opus~"));
@@ -4,157 +4,292 @@
 @date 2016-08-26
 @license GPLv3 or later
 
-speex~ encodes the signal with [SPEEX](https://en.wikipedia.org/wiki/Speex) in narrowband mode.
+speex~ encodes the signal with [SPEEX](https://en.wikipedia.org/wiki/Speex) in narrowband, wideband or ultra-wideband mode.
 
 Parameters:
-  speex~
+  speex~ RESAMPLER_QUALITY CHANNELS MODE QUALITY COMPLEXITY VBR
+
+  RESAMPLER_QUALITY: 0 (medium) [default], 1 (low latency), 2 (high)
+  CHANNELS: number of independent signals (default: 1)
+  MODE: 0 (narrowband; 8kHz) [default], 1 (wideband; 16kHz), 2 (ultra-wideband; 32kHz)
+  QUALITY: 0 (lowest bitrate) to 10 (best quality) (default: 8)
+  COMPLEXITY: 1 (lowest CPU load) to 10 (best quality); 0: default of libspeex (2)
+  VBR: 0 (constant bitrate) [default], 1 (variable bitrate)
 
 Inlets:
-  1x Audio inlet
+  CHANNELS x Audio inlet
   also bang: lose next frame
+  also latency: posts the latency (constant; prefill and resampler)
+  also worker 0/1: processes the frames on worker threads (adds one frame of latency; applied on the next DSP start)
+  also phase N: shifts the frame boundaries by N samples (internal sample rate; -1: automatic [default]; applied on the next DSP start)
+  also quality N: 0 (lowest bitrate) to 10 (best quality)
+  also complexity N: 1 (lowest CPU load) to 10 (best quality)
+  also vbr 0/1: constant (0) or variable (1) bitrate
+  also dtx 0/1: discontinuous transmission (enables voice activity detection; default: 0)
+
+Developer note: the settings are applied to the encoders before the next frames are processed (generic_codec_request_settings()), i.e., also in worker mode.
+Developer note: the encoders and decoders are created once and reset on DSP start (SPEEX_RESET_STATE).
+Developer note: a lost frame is concealed by the decoder (speex_decode_int() without bits).
 
 Outlets:
-  1x Audio outlet
+  CHANNELS x Audio outlet
 
 */
 
 #include <m_pd.h>
-#include <limits.h>
 #include <stdbool.h>
 #include <string.h>
 #include "ringbuffer.h"
 #include "generic_codec.h"
+#include "convert.h"
 
 #include <speex/speex.h>
 
+#define SPEEX_TILDE_QUALITY_DEFAULT 8
+
 static t_class *speex_tilde_class;
 
+typedef struct _speex_settings {
+  int quality;                  //0 to 10
+  int complexity;               //1 to 10; 0: default of libspeex
+  int vbr;
+  int dtx;
+} t_speex_settings;
+
 typedef struct _speex_tilde {
   t_object x_obj;
 
   t_generic_codec codec;
 
-  SpeexMode speex_mode;
-  SpeexBits speex_bits_encoder;
-  SpeexBits speex_bits_decoder;
+  const SpeexMode *speex_mode;
+  SpeexBits speex_bits_encoder;        //Shared by all channels (reset for every frame)
+  SpeexBits speex_bits_decoder;        //Shared by all channels (reset for every frame)
+
+  void **encoder;               //One per channel
+  void **decoder;               //One per channel
 
-  void *encoder;
-  void *decoder;
+  t_speex_settings settings;    //Requested by methods; applied to all encoders (speex_apply_settings())
 
   t_float float_inlet_unused;
 } t_speex_tilde;
 
-void speex_add_to_outbuffer (t_speex_tilde * x);
+void speex_process_frames (t_speex_tilde * x, unsigned int channel, unsigned int n, float *frames) {
+  unsigned int frame_size = x->codec.frame_size;
 
-t_int *speex_tilde_perform (t_int * w) {
-  t_speex_tilde *x = (t_speex_tilde *) (w[1]);
-  t_sample *in = (t_sample *) (w[2]);
-  t_sample *out = (t_sample *) (w[3]);
-  int n = (int) (w[4]);
+  for (unsigned int f = 0; f < n; f++) {
+    float *frame = &frames[f * frame_size];
 
-  generic_codec_resample_to_internal (&x->codec, n, in);
+    //Encode
+    short raw[frame_size];
+    convert_float_to_short (frame, raw, frame_size);
 
-  if (float_buffer_has_chunk (x->codec.ringbuffer_input)) {
-    speex_add_to_outbuffer (x);
-  }
+    speex_bits_reset (&x->speex_bits_encoder);
+    speex_encode_int (x->encoder[channel], raw, &x->speex_bits_encoder);
+    char encoded[speex_bits_nbytes (&x->speex_bits_encoder)];
+    unsigned int encoded_length = speex_bits_write (&x->speex_bits_encoder, encoded, speex_bits_nbytes (&x->speex_bits_encoder));
 
-  if (float_buffer_has_chunk (x->codec.ringbuffer_output)) {
-    generic_codec_to_outbuffer (&x->codec, out);
-  }
+    //Decode
+    if (x->codec.drop_next_frame[channel]) {
+      speex_decode_int (x->decoder[channel], NULL, raw);
+      x->codec.drop_next_frame[channel] = false;
+    } else {
+      speex_bits_read_from (&x->speex_bits_decoder, encoded, encoded_length);
+      speex_decode_int (x->decoder[channel], &x->speex_bits_decoder, raw);
+    }
 
-  return (w + 5);
+    convert_short_to_float (raw, frame, frame_size);
+  }
 }
 
-void speex_add_to_outbuffer (t_speex_tilde * x) {
-  bool free_required = false;
-  float *frame;
-  float_buffer_pop_chunk (x->codec.ringbuffer_input, &frame, x->codec.frame_size, &free_required);
+//Configures the encoder of a channel with the settings (helper function).
+void speex_tilde_configure (t_speex_tilde * x, unsigned int channel) {
+  void *encoder = x->encoder[channel];
+  const t_speex_settings *settings = &x->settings;
 
-  //Encode
-  short raw[x->codec.frame_size];
-  for (int i = 0; i < x->codec.frame_size; i++) {
-    raw[i] = SHRT_MAX * frame[i];
+  if (settings->complexity > 0) {
+    int complexity = settings->complexity;
+    speex_encoder_ctl (encoder, SPEEX_SET_COMPLEXITY, &complexity);
   }
+  int vbr = settings->vbr;
+  speex_encoder_ctl (encoder, SPEEX_SET_VBR, &vbr);
+  int quality = settings->quality;
+  speex_encoder_ctl (encoder, SPEEX_SET_QUALITY, &quality);
+  float vbr_quality = settings->quality;
+  speex_encoder_ctl (encoder, SPEEX_SET_VBR_QUALITY, &vbr_quality);
+  int dtx = settings->dtx;
+  speex_encoder_ctl (encoder, SPEEX_SET_VAD, &dtx);
+  speex_encoder_ctl (encoder, SPEEX_SET_DTX, &dtx);
+}
 
-  unsigned int frame_size;
-
-  speex_bits_reset (&x->speex_bits_encoder);
-  speex_encode_int (x->encoder, raw, &x->speex_bits_encoder);
-  char encoded[speex_bits_nbytes (&x->speex_bits_encoder)];
-  unsigned int encoded_length = speex_bits_write (&x->speex_bits_encoder, encoded, speex_bits_nbytes (&x->speex_bits_encoder));
-
-  //Decode
-  speex_bits_read_from (&x->speex_bits_decoder, encoded, encoded_length);
+//Applies the settings to the encoders of all channels (DSP-thread; callback of generic_codec).
+void speex_apply_settings (t_speex_tilde * x) {
+  for (unsigned int channel = 0; channel < x->codec.channels; channel++) {
+    if (x->encoder[channel] != NULL) {
+      speex_tilde_configure (x, channel);
+    }
+  }
+}
 
-  if (x->codec.drop_next_frame) {
-    speex_bits_read_from (&x->speex_bits_decoder, NULL, 0);
-    speex_decode_int (x->decoder, &x->speex_bits_decoder, raw);
-    x->codec.drop_next_frame = false;
-  } else {
-    speex_bits_read_from (&x->speex_bits_decoder, encoded, encoded_length);
-    speex_decode_int (x->decoder, &x->speex_bits_decoder, raw);
+void speex_quality (t_speex_tilde * x, t_floatarg quality) {
+  if ((int) quality < 0 || (int) quality > 10) {
+    error ("speex~: invalid quality specified (%d). Using %d.", (int) quality, SPEEX_TILDE_QUALITY_DEFAULT);
+    quality = SPEEX_TILDE_QUALITY_DEFAULT;
   }
+  x->settings.quality = quality;
+  generic_codec_request_settings (&x->codec);
+}
 
-  for (int i = 0; i < x->codec.frame_size; i++) {
-    frame[i] = (float) raw[i] / SHRT_MAX;
+void speex_complexity (t_speex_tilde * x, t_floatarg complexity) {
+  if ((int) complexity < 1 || (int) complexity > 10) {
+    error ("speex~: invalid complexity specified (%d). Using 10.", (int) complexity);
+    complexity = 10;
   }
+  x->settings.complexity = complexity;
+  generic_codec_request_settings (&x->codec);
+}
 
-  generic_codec_resample_to_external (&x->codec, x->codec.frame_size, frame);
+void speex_vbr (t_speex_tilde * x, t_floatarg vbr) {
+  x->settings.vbr = vbr != 0;
+  generic_codec_request_settings (&x->codec);
+}
 
-  if (free_required) {
-    free (frame);
-  }
+void speex_dtx (t_speex_tilde * x, t_floatarg dtx) {
+  x->settings.dtx = dtx != 0;
+  generic_codec_request_settings (&x->codec);
 }
 
 void speex_packet_loss (t_speex_tilde * x) {
-  x->codec.drop_next_frame = true;
+  generic_codec_drop_next_frame (&x->codec);
+}
+
+void speex_latency (t_speex_tilde * x) {
+  generic_codec_post_latency (&x->codec, "speex~");
+}
+
+void speex_worker (t_speex_tilde * x, t_floatarg worker) {
+  generic_codec_set_worker (&x->codec, "speex~", worker != 0);
 }
 
+void speex_phase (t_speex_tilde * x, t_floatarg phase) {
+  generic_codec_set_phase (&x->codec, "speex~", phase);
+}
+
+//Resets the encoders and decoders (allocation-free).
 void speex_tilde_dsp (t_speex_tilde * x, t_signal ** sp) {
-  speex_bits_init (&x->speex_bits_encoder);
-  x->encoder = speex_encoder_init (&x->speex_mode);
+  generic_codec_dsp_stop (&x->codec);
 
-  speex_bits_init (&x->speex_bits_decoder);
-  x->decoder = speex_decoder_init (&x->speex_mode);
+  for (unsigned int channel = 0; channel < x->codec.channels; channel++) {
+    speex_encoder_ctl (x->encoder[channel], SPEEX_RESET_STATE, NULL);
+    speex_decoder_ctl (x->decoder[channel], SPEEX_RESET_STATE, NULL);
+  }
 
-  generic_codec_dsp_add (&x->codec, sp[0]->s_n, x, speex_tilde_perform, sp);
+  generic_codec_dsp_add (&x->codec, sp[0]->s_n, &x->codec, generic_codec_perform, sp);
 }
 
 void speex_tilde_free (t_speex_tilde * x) {
-  if (x->encoder != NULL) {
-    speex_decoder_destroy (x->encoder);
-  }
-  if (x->decoder != NULL) {
-    speex_decoder_destroy (x->decoder);
-  }
   generic_codec_free (&x->codec);
+
+  for (unsigned int channel = 0; channel < x->codec.channels; channel++) {
+    if (x->encoder[channel] != NULL) {
+      speex_encoder_destroy (x->encoder[channel]);
+    }
+    if (x->decoder[channel] != NULL) {
+      speex_decoder_destroy (x->decoder[channel]);
+    }
+  }
+  free (x->encoder);
+  free (x->decoder);
+
+  speex_bits_destroy (&x->speex_bits_encoder);
+  speex_bits_destroy (&x->speex_bits_decoder);
 }
 
-void *speex_tilde_new () {
+void *speex_tilde_new (t_symbol * s, int argc, t_atom * argv) {
+  (void) s;
   t_speex_tilde *x = (t_speex_tilde *) pd_new (speex_tilde_class);
 
-  x->speex_mode = speex_nb_mode;
+  t_float resampler_quality = atom_getfloatarg (0, argc, argv);
+  t_float channels = atom_getfloatarg (1, argc, argv);
+  t_float mode = atom_getfloatarg (2, argc, argv);
+  t_float quality = argc > 3 ? atom_getfloatarg (3, argc, argv) : SPEEX_TILDE_QUALITY_DEFAULT;
+  t_float complexity = atom_getfloatarg (4, argc, argv);
+  t_float vbr = atom_getfloatarg (5, argc, argv);
+
+  if ((int) resampler_quality < 0 || (int) resampler_quality > 2) {
+    error ("speex~: invalid resampler quality specified (%d). Using 0 (medium).", (int) resampler_quality);
+    resampler_quality = RESAMPLER_QUALITY_MEDIUM;
+  }
+
+  if ((int) channels == 0) {
+    channels = 1;               //Default: mono
+  }
+  if ((int) channels < 1 || (int) channels > GENERIC_CODEC_CHANNELS_MAX) {
+    error ("speex~: invalid number of channels specified (%d). Using 1.", (int) channels);
+    channels = 1;
+  }
+
+  if ((int) mode < 0 || (int) mode > 2) {
+    error ("speex~: invalid mode specified (%d). Using 0 (narrowband).", (int) mode);
+    mode = 0;
+  }
+  const float sample_rate[] = { 8000, 16000, 32000 };   //Narrowband, wideband, ultra-wideband
+
+  if ((int) quality < 0 || (int) quality > 10) {
+    error ("speex~: invalid quality specified (%d). Using %d.", (int) quality, SPEEX_TILDE_QUALITY_DEFAULT);
+    quality = SPEEX_TILDE_QUALITY_DEFAULT;
+  }
+
+  if ((int) complexity < 0 || (int) complexity > 10) {
+    error ("speex~: invalid complexity specified (%d). Using 0 (default).", (int) complexity);
+    complexity = 0;
+  }
 
-  //Get frame size: create an encoder and destroy it afterwards
-  unsigned int frame_size;
+  if ((int) vbr != 0 && (int) vbr != 1) {
+    error ("speex~: invalid vbr specified (%d). Using 0 (constant bitrate).", (int) vbr);
+    vbr = 0;
+  }
+
+  x->settings.quality = quality;
+  x->settings.complexity = complexity;
+  x->settings.vbr = vbr;
+  x->settings.dtx = 0;
+
+  x->speex_mode = speex_lib_get_mode (SPEEX_MODEID_NB + (int) mode);
   speex_bits_init (&x->speex_bits_encoder);
-  x->encoder = speex_encoder_init (&x->speex_mode);
-  speex_encoder_ctl (x->encoder, SPEEX_GET_FRAME_SIZE, &frame_size);
-  speex_encoder_destroy (x->encoder);
-  speex_bits_destroy (&x->speex_bits_encoder);
+  speex_bits_init (&x->speex_bits_decoder);
+
+  x->encoder = calloc (channels, sizeof (void *));
+  x->decoder = calloc (channels, sizeof (void *));
+  for (unsigned int channel = 0; channel < (unsigned int) channels; channel++) {
+    x->encoder[channel] = speex_encoder_init (x->speex_mode);
+    x->decoder[channel] = speex_decoder_init (x->speex_mode);
+  }
 
-  generic_codec_init (&x->codec, &x->x_obj, 8000, frame_size);
+  int frame_size;
+  speex_encoder_ctl (x->encoder[0], SPEEX_GET_FRAME_SIZE, &frame_size);
+
+  generic_codec_init (&x->codec, &x->x_obj, sample_rate[(int) mode], frame_size, resampler_quality, channels, (t_generic_codec_process_frames) speex_process_frames);
+  x->codec.apply_settings = (t_generic_codec_apply_settings) speex_apply_settings;
+
+  for (unsigned int channel = 0; channel < x->codec.channels; channel++) {
+    speex_tilde_configure (x, channel);
+  }
 
-  post ("speex~: Created with frame size (%d) and sample rate (%f).", x->codec.frame_size, x->codec.sample_rate_internal);
+  post ("speex~: Created with frame size (%d), sample rate (%f), quality (%d), complexity (%d), and vbr (%d) for %d channel(s).", x->codec.frame_size, x->codec.sample_rate_internal, x->settings.quality, x->settings.complexity, x->settings.vbr, x->codec.channels);
 
-  x->decoder = NULL;
-  x->encoder = NULL;
   return (void *) x;
 }
 
 void speex_tilde_setup (void) {
-  speex_tilde_class = class_new (gensym ("speex~"), (t_newmethod) speex_tilde_new, (t_method) speex_tilde_free, sizeof (t_speex_tilde), CLASS_DEFAULT, 0);
+  speex_tilde_class = class_new (gensym ("speex~"), (t_newmethod) speex_tilde_new, (t_method) speex_tilde_free, sizeof (t_speex_tilde), CLASS_DEFAULT, A_GIMME, 0);
   class_addmethod (speex_tilde_class, (t_method) speex_tilde_dsp, gensym ("dsp"), 0);
+  class_addmethod (speex_tilde_class, (t_method) speex_latency, gensym ("latency"), 0);
+  class_addmethod (speex_tilde_class, (t_method) speex_worker, gensym ("worker"), A_FLOAT, 0);
+  class_addmethod (speex_tilde_class, (t_method) speex_phase, gensym ("phase"), A_FLOAT, 0);
+  class_addmethod (speex_tilde_class, (t_method) speex_quality, gensym ("quality"), A_FLOAT, 0);
+  class_addmethod (speex_tilde_class, (t_method) speex_complexity, gensym ("complexity"), A_FLOAT, 0);
+  class_addmethod (speex_tilde_class, (t_method) speex_vbr, gensym ("vbr"), A_FLOAT, 0);
+  class_addmethod (speex_tilde_class, (t_method) speex_dtx, gensym ("dtx"), A_FLOAT, 0);
   class_addbang (speex_tilde_class, speex_packet_loss);
   CLASS_MAINSIGNALIN (speex_tilde_class, t_speex_tilde, float_inlet_unused);
   class_sethelpsymbol (speex_tilde_class, gensym ("speex~"));
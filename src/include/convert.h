@@ -0,0 +1,112 @@
+/**
+@file convert.h
+@author Frank Haase, Dennis Guse
+@date 2026-10-16
+@license GPLv3 or later
+
+Conversion between float samples (-1 to 1) and 16-bit PCM (short) as required by most codecs.
+
+float to short: scaled by SHRT_MAX, rounded to nearest (ties to even) and saturated to [SHRT_MIN, SHRT_MAX].
+short to float: divided by SHRT_MAX.
+
+The implementation is selected at build time: AVX2, SSE2, NEON (AArch64) or scalar.
+All implementations produce identical results.
+
+Developer note: NaN is converted to SHRT_MAX.
+Developer note: the scalar implementation requires the default rounding mode (round to nearest).
+
+*/
+
+#ifndef CONVERT_H_
+#define CONVERT_H_
+
+#include <limits.h>
+#include <math.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+//Converts one sample (helper function; also used for the remainder of the SIMD implementations).
+static inline short convert_float_to_short_scalar (float sample) {
+  float scaled = sample * SHRT_MAX;
+  scaled = scaled < SHRT_MAX ? scaled : SHRT_MAX;       //Same order as min/max of SSE: NaN yields SHRT_MAX
+  scaled = scaled > SHRT_MIN ? scaled : SHRT_MIN;
+  return (short) lrintf (scaled);
+}
+
+static inline void convert_float_to_short (const float *src, short *dst, unsigned int n) {
+  unsigned int i = 0;
+
+#if defined(__AVX2__)
+  const __m256 scale = _mm256_set1_ps (SHRT_MAX);
+  const __m256 max = _mm256_set1_ps (SHRT_MAX);
+  const __m256 min = _mm256_set1_ps (SHRT_MIN);
+  for (; i + 16 <= n; i += 16) {
+    __m256 a = _mm256_max_ps (_mm256_min_ps (_mm256_mul_ps (_mm256_loadu_ps (&src[i]), scale), max), min);
+    __m256 b = _mm256_max_ps (_mm256_min_ps (_mm256_mul_ps (_mm256_loadu_ps (&src[i + 8]), scale), max), min);
+    __m256i packed = _mm256_packs_epi32 (_mm256_cvtps_epi32 (a), _mm256_cvtps_epi32 (b));
+    _mm256_storeu_si256 ((__m256i *) & dst[i], _mm256_permute4x64_epi64 (packed, _MM_SHUFFLE (3, 1, 2, 0)));    //packs works per 128-bit lane
+  }
+#elif defined(__SSE2__)
+  const __m128 scale = _mm_set1_ps (SHRT_MAX);
+  const __m128 max = _mm_set1_ps (SHRT_MAX);
+  const __m128 min = _mm_set1_ps (SHRT_MIN);
+  for (; i + 8 <= n; i += 8) {
+    __m128 a = _mm_max_ps (_mm_min_ps (_mm_mul_ps (_mm_loadu_ps (&src[i]), scale), max), min);
+    __m128 b = _mm_max_ps (_mm_min_ps (_mm_mul_ps (_mm_loadu_ps (&src[i + 4]), scale), max), min);
+    _mm_storeu_si128 ((__m128i *) & dst[i], _mm_packs_epi32 (_mm_cvtps_epi32 (a), _mm_cvtps_epi32 (b)));
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  const float32x4_t scale = vdupq_n_f32 (SHRT_MAX);
+  for (; i + 8 <= n; i += 8) {
+    float32x4_t a = vmulq_f32 (vld1q_f32 (&src[i]), scale);
+    float32x4_t b = vmulq_f32 (vld1q_f32 (&src[i + 4]), scale);
+    //vcvtnq saturates to int32 (NaN: 0), so NaN is handled separately
+    int16x8_t packed = vcombine_s16 (vqmovn_s32 (vcvtnq_s32_f32 (a)), vqmovn_s32 (vcvtnq_s32_f32 (b)));
+    uint16x8_t nan = vcombine_u16 (vmovn_u32 (vmvnq_u32 (vceqq_f32 (a, a))), vmovn_u32 (vmvnq_u32 (vceqq_f32 (b, b))));
+    vst1q_s16 (&dst[i], vbslq_s16 (nan, vdupq_n_s16 (SHRT_MAX), packed));
+  }
+#endif
+
+  for (; i < n; i++) {
+    dst[i] = convert_float_to_short_scalar (src[i]);
+  }
+}
+
+static inline void convert_short_to_float (const short *src, float *dst, unsigned int n) {
+  unsigned int i = 0;
+
+#if defined(__AVX2__)
+  const __m256 scale = _mm256_set1_ps (SHRT_MAX);
+  for (; i + 8 <= n; i += 8) {
+    __m256i samples = _mm256_cvtepi16_epi32 (_mm_loadu_si128 ((const __m128i *) &src[i]));
+    _mm256_storeu_ps (&dst[i], _mm256_div_ps (_mm256_cvtepi32_ps (samples), scale));
+  }
+#elif defined(__SSE2__)
+  const __m128 scale = _mm_set1_ps (SHRT_MAX);
+  for (; i + 8 <= n; i += 8) {
+    __m128i samples = _mm_loadu_si128 ((const __m128i *) &src[i]);
+    __m128i sign = _mm_srai_epi16 (samples, 15);
+    _mm_storeu_ps (&dst[i], _mm_div_ps (_mm_cvtepi32_ps (_mm_unpacklo_epi16 (samples, sign)), scale));
+    _mm_storeu_ps (&dst[i + 4], _mm_div_ps (_mm_cvtepi32_ps (_mm_unpackhi_epi16 (samples, sign)), scale));
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  const float32x4_t scale = vdupq_n_f32 (SHRT_MAX);
+  for (; i + 8 <= n; i += 8) {
+    int16x8_t samples = vld1q_s16 (&src[i]);
+    vst1q_f32 (&dst[i], vdivq_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_low_s16 (samples))), scale));
+    vst1q_f32 (&dst[i + 4], vdivq_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_high_s16 (samples))), scale));
+  }
+#endif
+
+  for (; i < n; i++) {
+    dst[i] = (float) src[i] / SHRT_MAX;
+  }
+}
+
+#endif /* CONVERT_H_ */
@@ -0,0 +1,305 @@
+/**
+@file g711_plc.h
+@author Frank Haase, Dennis Guse
+@date 2026-10-16
+@license GPLv3 or later
+
+Optimized implementation of the packet loss concealment of G.711 (UGST/ITU-T G711 Appendix I; third-party/itu-t_stl2009_g711/lowcfe.c).
+
+Uses the state of the reference implementation (LowcFE_c; initialized with g711plc_construct()) and is identical to it except for the pitch search:
+  Correlation: four lags are computed at once (SIMD); each lag is summed in the same order as in the reference, so the correlation is identical.
+  Normalization: instead of comparing corr / sqrt(energy) per lag, the squared ratios are compared by cross-multiplication (double; sign preserved).
+The normalized correlation is thus compared more precisely than by the reference (float), so the pitch may differ if two lags are (almost) equally good.
+
+Developer note: the coarse search uses a decimated copy of the pitch buffer, so the four lags are contiguous.
+
+*/
+
+#ifndef G711_PLC_H_
+#define G711_PLC_H_
+
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+#include "lowcfe.h"
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+//Computes the correlation of l with r for four consecutive lags (r[0..3]); same summation order as the reference (helper function).
+static inline void g711_plc_correlate4 (const Float * r, const Float * l, unsigned int n, Float * corr) {
+#if defined(__SSE__) && !defined(USEDOUBLES)
+  __m128 sum = _mm_setzero_ps ();
+  for (unsigned int i = 0; i < n; i++) {
+    sum = _mm_add_ps (sum, _mm_mul_ps (_mm_loadu_ps (&r[i]), _mm_set1_ps (l[i])));
+  }
+  _mm_storeu_ps (corr, sum);
+#elif defined(__ARM_NEON) && !defined(USEDOUBLES)
+  float32x4_t sum = vdupq_n_f32 (0);
+  for (unsigned int i = 0; i < n; i++) {
+    sum = vaddq_f32 (sum, vmulq_f32 (vld1q_f32 (&r[i]), vdupq_n_f32 (l[i])));     //No fused multiply-add (identical rounding)
+  }
+  vst1q_f32 (corr, sum);
+#else
+  for (unsigned int k = 0; k < 4; k++) {
+    corr[k] = 0;
+    for (unsigned int i = 0; i < n; i++) {
+      corr[k] += r[k + i] * l[i];
+    }
+  }
+#endif
+}
+
+//Returns true if corr_a / sqrt(energy_a) > corr_b / sqrt(energy_b) (or >= if equal is true); energies must be positive (helper function).
+static inline bool g711_plc_better (Float corr_a, Float energy_a, Float corr_b, Float energy_b, bool equal) {
+  double a = (double) corr_a * fabs (corr_a) * energy_b;
+  double b = (double) corr_b * fabs (corr_b) * energy_a;
+  return equal ? a >= b : a > b;
+}
+
+//Estimates the pitch (see g711plc_findpitch() in lowcfe.c).
+static int g711_plc_findpitch (LowcFE_c * lc) {
+  Float *l = lc->pitchbufend - CORRLEN;
+  Float *r = lc->pitchbufend - CORRBUFLEN;
+
+  //Coarse search (every NDEC-th lag and sample): decimated copies
+  Float l_decimated[CORRLEN / NDEC];
+  Float r_decimated[CORRBUFLEN / NDEC + 4];
+  for (unsigned int i = 0; i < CORRLEN / NDEC; i++) {
+    l_decimated[i] = l[i * NDEC];
+  }
+  for (unsigned int i = 0; i < CORRBUFLEN / NDEC; i++) {
+    r_decimated[i] = r[i * NDEC];
+  }
+  for (unsigned int i = CORRBUFLEN / NDEC; i < CORRBUFLEN / NDEC + 4; i++) {
+    r_decimated[i] = 0;
+  }
+
+  Float corr[PITCHDIFF / NDEC + 4];
+  for (unsigned int lag = 0; lag <= PITCHDIFF / NDEC; lag += 4) {
+    g711_plc_correlate4 (&r_decimated[lag], l_decimated, CORRLEN / NDEC, &corr[lag]);
+  }
+
+  Float *rp = r;
+  Float energy = 0;
+  for (int i = 0; i < CORRLEN; i += NDEC) {
+    energy += rp[i] * rp[i];
+  }
+  Float bestcorr = corr[0];
+  Float bestscale = energy < CORRMINPOWER ? CORRMINPOWER : energy;
+  int bestmatch = 0;
+  for (int j = NDEC; j <= PITCHDIFF; j += NDEC) {
+    energy -= rp[0] * rp[0];
+    energy += rp[CORRLEN] * rp[CORRLEN];
+    rp += NDEC;
+
+    Float scale = energy < CORRMINPOWER ? CORRMINPOWER : energy;
+    if (g711_plc_better (corr[j / NDEC], scale, bestcorr, bestscale, true)) {
+      bestcorr = corr[j / NDEC];
+      bestscale = scale;
+      bestmatch = j;
+    }
+  }
+
+  //Fine search (every lag and sample around the coarse result)
+  int j = bestmatch - (NDEC - 1);
+  if (j < 0) {
+    j = 0;
+  }
+  int k = bestmatch + (NDEC - 1);
+  if (k > PITCHDIFF) {
+    k = PITCHDIFF;
+  }
+
+  rp = &r[j];
+  energy = 0;
+  Float correlation = 0;
+  for (int i = 0; i < CORRLEN; i++) {
+    energy += rp[i] * rp[i];
+    correlation += rp[i] * l[i];
+  }
+  bestcorr = correlation;
+  bestscale = energy < CORRMINPOWER ? CORRMINPOWER : energy;
+  bestmatch = j;
+  for (j++; j <= k; j++) {
+    energy -= rp[0] * rp[0];
+    energy += rp[CORRLEN] * rp[CORRLEN];
+    rp++;
+
+    correlation = 0;
+    for (int i = 0; i < CORRLEN; i++) {
+      correlation += rp[i] * l[i];
+    }
+
+    Float scale = energy < CORRMINPOWER ? CORRMINPOWER : energy;
+    if (g711_plc_better (correlation, scale, bestcorr, bestscale, false)) {
+      bestcorr = correlation;
+      bestscale = scale;
+      bestmatch = j;
+    }
+  }
+  return PITCH_MAX - bestmatch;
+}
+
+//The following functions are identical to lowcfe.c (static there).
+
+static void g711_plc_convertsf (short *f, Float * t, int cnt) {
+  for (int i = 0; i < cnt; i++) {
+    t[i] = (Float) f[i];
+  }
+}
+
+static void g711_plc_convertfs (Float * f, short *t, int cnt) {
+  for (int i = 0; i < cnt; i++) {
+    t[i] = (short) f[i];
+  }
+}
+
+static void g711_plc_getfespeech (LowcFE_c * lc, short *out, int sz) {
+  while (sz) {
+    int cnt = lc->pitchblen - lc->poffset;
+    if (cnt > sz) {
+      cnt = sz;
+    }
+    g711_plc_convertfs (&lc->pitchbufstart[lc->poffset], out, cnt);
+    lc->poffset += cnt;
+    if (lc->poffset == lc->pitchblen) {
+      lc->poffset = 0;
+    }
+    out += cnt;
+    sz -= cnt;
+  }
+}
+
+static void g711_plc_scalespeech (LowcFE_c * lc, short *out) {
+  Float g = (Float) 1. - (lc->erasecnt - 1) * ATTENFAC;
+  for (int i = 0; i < FRAMESZ; i++) {
+    out[i] = (short) (out[i] * g);
+    g -= ATTENINCR;
+  }
+}
+
+static void g711_plc_savespeech (LowcFE_c * lc, short *s) {
+  memmove (lc->history, &lc->history[FRAMESZ], (HISTORYLEN - FRAMESZ) * sizeof (short));
+  memcpy (&lc->history[HISTORYLEN - FRAMESZ], s, FRAMESZ * sizeof (short));
+  memcpy (s, &lc->history[HISTORYLEN - FRAMESZ - POVERLAPMAX], FRAMESZ * sizeof (short));
+}
+
+static void g711_plc_overlapadd (Float * l, Float * r, Float * o, int cnt) {
+  if (cnt == 0) {
+    return;
+  }
+  Float incr = (Float) 1. / cnt;
+  Float lw = (Float) 1. - incr;
+  Float rw = incr;
+  for (int i = 0; i < cnt; i++) {
+    Float t = lw * l[i] + rw * r[i];
+    if (t > (Float) 32767.) {
+      t = (Float) 32767.;
+    } else if (t < (Float) - 32768.) {
+      t = (Float) - 32768.;
+    }
+    o[i] = t;
+    lw -= incr;
+    rw += incr;
+  }
+}
+
+static void g711_plc_overlapadds (short *l, short *r, short *o, int cnt) {
+  if (cnt == 0) {
+    return;
+  }
+  Float incr = (Float) 1. / cnt;
+  Float lw = (Float) 1. - incr;
+  Float rw = incr;
+  for (int i = 0; i < cnt; i++) {
+    Float t = lw * l[i] + rw * r[i];
+    if (t > (Float) 32767.) {
+      t = (Float) 32767.;
+    } else if (t < (Float) - 32768.) {
+      t = (Float) - 32768.;
+    }
+    o[i] = (short) t;
+    lw -= incr;
+    rw += incr;
+  }
+}
+
+static void g711_plc_overlapaddatend (LowcFE_c * lc, short *s, short *f, int cnt) {
+  Float incr = (Float) 1. / cnt;
+  Float gain = (Float) 1. - (lc->erasecnt - 1) * ATTENFAC;
+  if (gain < 0.) {
+    gain = (Float) 0.;
+  }
+  Float incrg = incr * gain;
+  Float lw = ((Float) 1. - incr) * gain;
+  Float rw = incr;
+  for (int i = 0; i < cnt; i++) {
+    Float t = lw * f[i] + rw * s[i];
+    if (t > 32767.) {
+      t = (Float) 32767.;
+    } else if (t < -32768.) {
+      t = (Float) - 32768.;
+    }
+    s[i] = (short) t;
+    lw -= incrg;
+    rw += incr;
+  }
+}
+
+//Synthesizes one frame (FRAMESZ samples) for an erasure (see g711plc_dofe()).
+static void g711_plc_dofe (LowcFE_c * lc, short *out) {
+  if (lc->erasecnt == 0) {
+    g711_plc_convertsf (lc->history, lc->pitchbuf, HISTORYLEN);
+    lc->pitch = g711_plc_findpitch (lc);
+    lc->poverlap = lc->pitch >> 2;
+    memcpy (lc->lastq, lc->pitchbufend - lc->poverlap, lc->poverlap * sizeof (Float));
+    lc->poffset = 0;
+    lc->pitchblen = lc->pitch;
+    lc->pitchbufstart = lc->pitchbufend - lc->pitchblen;
+    g711_plc_overlapadd (lc->lastq, lc->pitchbufstart - lc->poverlap, lc->pitchbufend - lc->poverlap, lc->poverlap);
+    g711_plc_convertfs (lc->pitchbufend - lc->poverlap, &lc->history[HISTORYLEN - lc->poverlap], lc->poverlap);
+    g711_plc_getfespeech (lc, out, FRAMESZ);
+  } else if (lc->erasecnt == 1 || lc->erasecnt == 2) {
+    short tmp[POVERLAPMAX];
+    int saveoffset = lc->poffset;
+    g711_plc_getfespeech (lc, tmp, lc->poverlap);
+    lc->poffset = saveoffset;
+    while (lc->poffset > lc->pitch) {
+      lc->poffset -= lc->pitch;
+    }
+    lc->pitchblen += lc->pitch;
+    lc->pitchbufstart = lc->pitchbufend - lc->pitchblen;
+    g711_plc_overlapadd (lc->lastq, lc->pitchbufstart - lc->poverlap, lc->pitchbufend - lc->poverlap, lc->poverlap);
+    g711_plc_getfespeech (lc, out, FRAMESZ);
+    g711_plc_overlapadds (tmp, out, out, lc->poverlap);
+    g711_plc_scalespeech (lc, out);
+  } else if (lc->erasecnt > 5) {
+    memset (out, 0, FRAMESZ * sizeof (short));
+  } else {
+    g711_plc_getfespeech (lc, out, FRAMESZ);
+    g711_plc_scalespeech (lc, out);
+  }
+  lc->erasecnt++;
+  g711_plc_savespeech (lc, out);
+}
+
+//Adds a received frame (FRAMESZ samples) to the history; output is delayed by POVERLAPMAX (see g711plc_addtohistory()).
+static void g711_plc_addtohistory (LowcFE_c * lc, short *s) {
+  if (lc->erasecnt) {
+    short overlapbuf[FRAMESZ];
+    int olen = lc->poverlap + (lc->erasecnt - 1) * EOVERLAPINCR;
+    if (olen > FRAMESZ) {
+      olen = FRAMESZ;
+    }
+    g711_plc_getfespeech (lc, overlapbuf, olen);
+    g711_plc_overlapaddatend (lc, s, overlapbuf, olen);
+    lc->erasecnt = 0;
+  }
+  g711_plc_savespeech (lc, s);
+}
+
+#endif /* G711_PLC_H_ */
@@ -0,0 +1,102 @@
+/**
+@file g711_table.h
+@author Frank Haase, Dennis Guse
+@date 2026-10-16
+@license GPLv3 or later
+
+Table-driven G.711 (A-law and µ-law) encoder and decoder.
+
+The tables are computed once (g711_table_init()) with the reference implementation (ITU-T STL 2009, g711.c), so the results are bit-exact.
+Encoding: A-law only uses the 12 MSBs and µ-law the 14 MSBs of a sample, so one table entry covers 16 (A-law) or 4 (µ-law) samples.
+Decoding: 256 entries; uses a vectorized gather if AVX2 is available (selected at build time).
+
+Developer note: the encoded samples are stored as uint8_t (8 bit, without sign extension as in g711.c).
+Developer note: the tables are shared by all instances of one external (static variables).
+
+*/
+
+#ifndef G711_TABLE_H_
+#define G711_TABLE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "g711.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#define G711_TABLE_ALAW 0
+#define G711_TABLE_ULAW 1
+
+#define G711_TABLE_ALAW_SHIFT 4
+#define G711_TABLE_ULAW_SHIFT 2
+
+typedef struct _g711_table {
+  unsigned int shift;           //Number of LSBs ignored by the encoder
+  uint8_t *encode;              //Index: sample >> shift (offset by 2^(15 - shift))
+  int32_t decode[256];          //32 bit for gather
+} t_g711_table;
+
+static uint8_t g711_table_alaw_encode[1 << (16 - G711_TABLE_ALAW_SHIFT)];
+static uint8_t g711_table_ulaw_encode[1 << (16 - G711_TABLE_ULAW_SHIFT)];
+
+static t_g711_table g711_tables[2] = {
+  [G711_TABLE_ALAW] = {.shift = G711_TABLE_ALAW_SHIFT,.encode = g711_table_alaw_encode},
+  [G711_TABLE_ULAW] = {.shift = G711_TABLE_ULAW_SHIFT,.encode = g711_table_ulaw_encode}
+};
+
+static bool g711_table_initialized = false;
+
+//Computes the tables for one law with the reference implementation (helper function).
+static void g711_table_fill (t_g711_table * table, void (*compress) (long, short *, short *), void (*expand) (long, short *, short *)) {
+  unsigned int size = 1 << (16 - table->shift);
+  for (unsigned int i = 0; i < size; i++) {
+    short linear = (short) ((int) (i << table->shift) - 32768);
+    short log;
+    compress (1, &linear, &log);
+    table->encode[i] = log;
+  }
+
+  for (unsigned int i = 0; i < 256; i++) {
+    short log = i;
+    short linear;
+    expand (1, &log, &linear);
+    table->decode[i] = linear;
+  }
+}
+
+//Computes the tables (once).
+static void g711_table_init () {
+  if (g711_table_initialized) {
+    return;
+  }
+  g711_table_fill (&g711_tables[G711_TABLE_ALAW], alaw_compress, alaw_expand);
+  g711_table_fill (&g711_tables[G711_TABLE_ULAW], ulaw_compress, ulaw_expand);
+  g711_table_initialized = true;
+}
+
+static inline void g711_table_compress (const t_g711_table * table, unsigned int n, const short *linear, uint8_t * log) {
+  const int offset = 1 << (15 - table->shift);
+  for (unsigned int i = 0; i < n; i++) {
+    log[i] = table->encode[(linear[i] >> table->shift) + offset];
+  }
+}
+
+static inline void g711_table_expand (const t_g711_table * table, unsigned int n, const uint8_t * log, short *linear) {
+  unsigned int i = 0;
+
+#if defined(__AVX2__)
+  for (; i + 8 <= n; i += 8) {
+    __m256i index = _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i *) &log[i]));
+    __m256i samples = _mm256_i32gather_epi32 ((const int *) table->decode, index, 4);
+    _mm_storeu_si128 ((__m128i *) & linear[i], _mm_packs_epi32 (_mm256_castsi256_si128 (samples), _mm256_extracti128_si256 (samples, 1)));
+  }
+#endif
+
+  for (; i < n; i++) {
+    linear[i] = table->decode[log[i]];
+  }
+}
+
+#endif /* G711_TABLE_H_ */
@@ -0,0 +1,215 @@
+/**
+@file g722_plc.h
+@author Frank Haase, Dennis Guse
+@date 2026-10-16
+@license GPLv3 or later
+
+Packet loss concealment for G.722 (16kHz; spandsp, third-party/spanddsp_g722) similar to ITU-T G.722 Appendix III/IV.
+
+Concealment: the last pitch period of the decoded signal is repeated.
+  Pitch: normalized cross-correlation of the last 20ms with the preceding signal (80 to 240 samples; coarse search on every 4th sample and lag, then fine search).
+  Lower band (below 4kHz; [1 2 1] / 4 of the pitch period): not attenuated for 10ms, then linearly attenuated until muted after 60ms.
+  Higher band (remainder): linearly attenuated until muted after 20ms.
+  The end of the pitch period is overlapped with the preceding period and the transition from the decoded signal is corrected by a decaying offset.
+Re-convergence: the concealed signal is re-encoded (encoder initialized with the state of the decoder) and the decoder decodes this signal (output discarded).
+  Thus, the state of the decoder (ADPCM and QMF) follows the concealed signal and the first received frame continues from it.
+  The first received frame is cross-faded with the concealed signal (overlap increases with the duration of the loss).
+
+Developer note: the QMF (analysis and synthesis) delays the signal by G722_PLC_DELAY samples, so the concealed signal is re-encoded ahead by that delay.
+Developer note: requires decoding to 16kHz (i.e., G722_SAMPLE_RATE_8000 not set) and unpacked G.722 data.
+
+@see g711_plc.h
+*/
+
+#ifndef G722_PLC_H_
+#define G722_PLC_H_
+
+#include <math.h>
+#include <string.h>
+#include "g722.h"
+
+#define G722_PLC_DELAY 22       //Samples
+#define G722_PLC_PITCH_MIN 80   //Samples (200Hz)
+#define G722_PLC_PITCH_MAX 240  //Samples (66.7Hz)
+#define G722_PLC_CORRELATION_LENGTH 320
+#define G722_PLC_DECIMATION 4   //Coarse pitch search
+#define G722_PLC_HISTORY_LENGTH (G722_PLC_PITCH_MAX + G722_PLC_CORRELATION_LENGTH)
+
+#define G722_PLC_ATTENUATION_START 160  //Samples until the lower band is attenuated
+#define G722_PLC_ATTENUATION_LENGTH 800 //Samples until the lower band is muted (after start)
+#define G722_PLC_HIGH_ATTENUATION_LENGTH 320    //Samples until the higher band is muted
+#define G722_PLC_OVERLAP_INCREMENT 64   //Overlap of the first received frame per G722_PLC_OVERLAP_PERIOD of loss
+#define G722_PLC_OVERLAP_PERIOD 160     //Samples (10ms)
+
+typedef struct _g722_plc {
+  short history[G722_PLC_HISTORY_LENGTH];       //Last output samples
+
+  float low[G722_PLC_PITCH_MAX];        //Pitch period: lower band
+  float high[G722_PLC_PITCH_MAX];       //Pitch period: higher band
+  unsigned int pitch;
+  unsigned int overlap;         //Samples (1/4 of the pitch)
+  float offset;                 //Transition from the decoded signal
+
+  unsigned int erased;          //Concealed samples of the current loss (0: no loss)
+
+  g722_encode_state_t encoder;  //Re-encodes the concealed signal
+} t_g722_plc;
+
+static void g722_plc_init (t_g722_plc * plc) {
+  memset (plc, 0, sizeof (t_g722_plc));
+}
+
+//Estimates the pitch of the history (helper function).
+static unsigned int g722_plc_findpitch (const short *history) {
+  const short *l = &history[G722_PLC_HISTORY_LENGTH - G722_PLC_CORRELATION_LENGTH];
+
+  //Normalized correlation (squared; sign preserved) of l with the signal pitch samples before; step: sample distance
+  float best_score = -INFINITY;
+  unsigned int best_pitch = G722_PLC_PITCH_MIN;
+  for (unsigned int pitch = G722_PLC_PITCH_MIN; pitch <= G722_PLC_PITCH_MAX; pitch += G722_PLC_DECIMATION) {
+    const short *r = l - pitch;
+    float correlation = 0;
+    float energy = 1;
+    for (unsigned int i = 0; i < G722_PLC_CORRELATION_LENGTH; i += G722_PLC_DECIMATION) {
+      correlation += (float) l[i] * r[i];
+      energy += (float) r[i] * r[i];
+    }
+    float score = correlation * fabsf (correlation) / energy;
+    if (score > best_score) {
+      best_score = score;
+      best_pitch = pitch;
+    }
+  }
+
+  unsigned int first = best_pitch - (G722_PLC_DECIMATION - 1) < G722_PLC_PITCH_MIN ? G722_PLC_PITCH_MIN : best_pitch - (G722_PLC_DECIMATION - 1);
+  unsigned int last = best_pitch + (G722_PLC_DECIMATION - 1) > G722_PLC_PITCH_MAX ? G722_PLC_PITCH_MAX : best_pitch + (G722_PLC_DECIMATION - 1);
+  best_score = -INFINITY;
+  for (unsigned int pitch = first; pitch <= last; pitch++) {
+    const short *r = l - pitch;
+    float correlation = 0;
+    float energy = 1;
+    for (unsigned int i = 0; i < G722_PLC_CORRELATION_LENGTH; i++) {
+      correlation += (float) l[i] * r[i];
+      energy += (float) r[i] * r[i];
+    }
+    float score = correlation * fabsf (correlation) / energy;
+    if (score > best_score) {
+      best_score = score;
+      best_pitch = pitch;
+    }
+  }
+  return best_pitch;
+}
+
+//Prepares the pitch period at the beginning of a loss (helper function).
+static void g722_plc_start (t_g722_plc * plc) {
+  const short *end = &plc->history[G722_PLC_HISTORY_LENGTH];
+  unsigned int pitch = g722_plc_findpitch (plc->history);
+  unsigned int overlap = pitch >> 2;
+
+  float period[G722_PLC_PITCH_MAX];
+  for (unsigned int i = 0; i < pitch - overlap; i++) {
+    period[i] = end[(int) i - (int) pitch];
+  }
+  for (unsigned int i = pitch - overlap; i < pitch; i++) {
+    float w = (float) (i - (pitch - overlap) + 1) / (overlap + 1);
+    period[i] = (1 - w) * end[(int) i - (int) pitch] + w * end[(int) i - 2 * (int) pitch];
+  }
+
+  //Split: [1 2 1] / 4 (periodic signal)
+  for (unsigned int i = 0; i < pitch; i++) {
+    float previous = period[(i + pitch - 1) % pitch];
+    float next = period[(i + 1) % pitch];
+    plc->low[i] = 0.25f * previous + 0.5f * period[i] + 0.25f * next;
+    plc->high[i] = period[i] - plc->low[i];
+  }
+
+  plc->pitch = pitch;
+  plc->overlap = overlap;
+  plc->offset = end[-1] - period[pitch - 1];
+}
+
+//Returns the concealed sample t (samples since the beginning of the loss) (helper function).
+static inline short g722_plc_sample (const t_g722_plc * plc, unsigned int t) {
+  float gain_low = 1;
+  if (t >= G722_PLC_ATTENUATION_START + G722_PLC_ATTENUATION_LENGTH) {
+    return 0;
+  } else if (t > G722_PLC_ATTENUATION_START) {
+    gain_low = 1 - (float) (t - G722_PLC_ATTENUATION_START) / G722_PLC_ATTENUATION_LENGTH;
+  }
+  float gain_high = t < G722_PLC_HIGH_ATTENUATION_LENGTH ? 1 - (float) t / G722_PLC_HIGH_ATTENUATION_LENGTH : 0;
+
+  unsigned int i = t % plc->pitch;
+  float low = plc->low[i];
+  if (t < plc->overlap) {
+    low += plc->offset * (1 - (float) (t + 1) / (plc->overlap + 1));
+  }
+
+  float sample = gain_low * low + gain_high * plc->high[i];
+  if (sample > 32767) {
+    sample = 32767;
+  } else if (sample < -32768) {
+    sample = -32768;
+  }
+  return (short) lrintf (sample);
+}
+
+//Appends output samples to the history (helper function).
+static void g722_plc_addtohistory (t_g722_plc * plc, const short *s, unsigned int n) {
+  if (n >= G722_PLC_HISTORY_LENGTH) {
+    memcpy (plc->history, &s[n - G722_PLC_HISTORY_LENGTH], G722_PLC_HISTORY_LENGTH * sizeof (short));
+    return;
+  }
+  memmove (plc->history, &plc->history[n], (G722_PLC_HISTORY_LENGTH - n) * sizeof (short));
+  memcpy (&plc->history[G722_PLC_HISTORY_LENGTH - n], s, n * sizeof (short));
+}
+
+//Synthesizes n samples for a lost frame and updates the state of the decoder.
+static void g722_plc_conceal (t_g722_plc * plc, g722_decode_state_t * decoder, short *out, unsigned int n) {
+  if (plc->erased == 0) {
+    g722_plc_start (plc);
+
+    //Encoder: state of the decoder; QMF history of the (delayed) input
+    memset (&plc->encoder, 0, sizeof (g722_encode_state_t));
+    plc->encoder.itu_test_mode = decoder->itu_test_mode;
+    plc->encoder.bits_per_sample = decoder->bits_per_sample;
+    memcpy (plc->encoder.band, decoder->band, sizeof (plc->encoder.band));
+    for (int i = 0; i < 24; i++) {
+      int t = i - 24 + G722_PLC_DELAY;
+      plc->encoder.x[i] = t < 0 ? plc->history[G722_PLC_HISTORY_LENGTH + t] : g722_plc_sample (plc, t);
+    }
+  }
+
+  short ahead[n];
+  for (unsigned int i = 0; i < n; i++) {
+    out[i] = g722_plc_sample (plc, plc->erased + i);
+    ahead[i] = g722_plc_sample (plc, plc->erased + i + G722_PLC_DELAY);
+  }
+  plc->erased += n;
+
+  //Re-convergence
+  uint8_t encoded[n];
+  int encoded_length = g722_encode (&plc->encoder, encoded, ahead, n);
+  g722_decode (decoder, ahead, encoded, encoded_length);
+
+  g722_plc_addtohistory (plc, out, n);
+}
+
+//Adds n received (decoded) samples; the first received frame after a loss is cross-faded with the concealed signal.
+static void g722_plc_receive (t_g722_plc * plc, short *s, unsigned int n) {
+  if (plc->erased) {
+    unsigned int overlap = plc->overlap + (plc->erased - 1) / G722_PLC_OVERLAP_PERIOD * G722_PLC_OVERLAP_INCREMENT;
+    if (overlap > n) {
+      overlap = n;
+    }
+    for (unsigned int i = 0; i < overlap; i++) {
+      float w = (float) (i + 1) / (overlap + 1);
+      float sample = (1 - w) * g722_plc_sample (plc, plc->erased + i) + w * s[i];
+      s[i] = (short) lrintf (sample);
+    }
+    plc->erased = 0;
+  }
+  g722_plc_addtohistory (plc, s, n);
+}
+
+#endif /* G722_PLC_H_ */
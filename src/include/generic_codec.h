@@ -8,137 +8,626 @@ Contains generic data structure and functions required to implement codecs.
 This includes resampler (input, output), ringbuffer (input, output) etc.
 
 Developer note: both ringbuffers have a similar maximum size.
+Developer note: the perform-routines do not allocate memory; all memory is allocated in generic_codec_dsp_add().
+Developer note: the resamplers are kept on DSP restart (only reset) if PureData's sample rate did not change.
+Developer note: all channels are processed in lockstep, i.e., the ringbuffers of all channels always contain the same number of elements.
 
-Audio signal flow:
+Audio signal flow (per channel):
   inlet -> resampler_input -> ringbuffer_input -> CODEC -> resampler_output -> ringbuffer_output -> outlet
 
+Channels: a codec processes 1 to GENERIC_CODEC_CHANNELS_MAX independent (mono) signals; each channel has its own inlet and outlet.
+The resamplers process all channels in one pass; buffers are stored per channel (structure of arrays).
+
+CODEC: all complete frames are removed from ringbuffer_input in every DSP tick and passed to the callback process_frames (one call per channel and tick).
+The frames are stored consecutively and must be replaced in-place by the processed frames (frame_size samples each).
+The codec must keep its state per channel.
+Use generic_codec_perform() as perform-routine or generic_codec_process_input() if the output is not resampled.
+process_frames must not call PureData's API; errors are reported via generic_codec_error().
+
+Phase: the frame boundaries of a codec are shifted by phase samples (sample_rate_internal), so codecs do not complete their frames in the same DSP tick.
+By default, the phase is assigned round-robin (one DSP block per codec, modulo frame_size); the round-robin counter is shared by all instances of one external.
+ringbuffer_input is filled with phase samples of silence and the prefill is reduced accordingly, i.e., the phase does not add latency.
+
+Worker mode and phase are changed by methods, but applied on the next DSP start (generic_codec_dsp_add()); the DSP is not restarted, as this would rebuild the DSP graph of all objects.
+
+Worker mode (opt-in, generic_codec_set_worker()): the frames are processed by a pool of worker threads (worker_pool.h) instead of the DSP-thread.
+The frames completed in one DSP tick are submitted as one job; the job adds the processed frames to handoff (ringbuffer_spsc.h; one per channel), which is drained by the DSP-thread in every DSP tick.
+The DSP-thread never waits for a job: if a worker is still running it, the next frames remain in ringbuffer_input and are submitted in a later DSP tick.
+Developer note: only one job per codec is submitted at a time; the job state (release/acquire) orders the accesses of the threads that run the job one after another, so handoff has a single producer at any time.
+
+Settings (e.g., the bitrate) changed by methods at runtime must not modify the state used by process_frames directly (worker threads).
+The external stores the requested values and calls generic_codec_request_settings(); the callback apply_settings is called on the DSP-thread before the next frames are processed (no job is running).
+
+Resampling is done by the polyphase resampler (resample.h); the quality is set by the external (RESAMPLER_QUALITY_*).
+
+Latency:
+  The output is delayed by a constant latency (computed in generic_codec_dsp_add()):
+    latency = prefill + phase + delay (sample_rate_external) + group delay (resampler_input) + group delay (resampler_output)
+  prefill: ringbuffer_output is filled with silence, so a complete block is available even if the current frame is not yet complete (one frame plus rounding).
+  Worker mode: the prefill additionally covers the processing time of a job (one frame rounded up to complete blocks) plus one block, as the output of a job is drained in the DSP tick after it is done.
+  If samples are missing nevertheless (e.g., a job took too long), silence is output and the same number of samples is skipped later (underrun), so the latency stays constant.
+  delay: delay added by the external (e.g., holding back packets), set before generic_codec_dsp_add().
+  The algorithmic delay of the codec itself (e.g., lookahead) is not included.
+
 */
 
 #ifndef GENERIC_CODEC_H_
 #define GENERIC_CODEC_H_
 
 #include <m_pd.h>
+#include <stdarg.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include "ringbuffer.h"
+#include "ringbuffer_spsc.h"
 #include "resample.h"
+#include "worker_pool.h"
+
+#define GENERIC_CODEC_CHANNELS_MAX 64
+#define GENERIC_CODEC_PHASE_AUTOMATIC -1
+
+static unsigned int generic_codec_phase_counter = 0;    //Round-robin phase: number of created codecs (per external)
+
+//Processes n frames of one channel in-place (frames: n x frame_size samples); x is the external.
+typedef void (*t_generic_codec_process_frames) (void *x, unsigned int channel, unsigned int n, float *frames);
+
+//Applies the settings requested by methods (DSP-thread; no frames are processed); x is the external.
+typedef void (*t_generic_codec_apply_settings) (void *x);
 
 typedef struct _generic_codec {
   float sample_rate_external;   //PureData's sample rate
   float sample_rate_internal;
 
+  unsigned int channels;
+
   unsigned int frame_size;      //Number of samples per frame (sample_rate_internal)
+  unsigned int frames_max;      //Maximal number of frames per DSP tick
+
+  t_generic_codec_process_frames process_frames;
+  void *owner;                  //The external (passed to process_frames)
+
+  unsigned int resampler_quality;
+
+  t_resampler *resampler_input;
+  float_buffer **ringbuffer_input;      //One per channel
 
-  void *resampler_input;
-  float_buffer *ringbuffer_input;
+  t_resampler *resampler_output;
+  float_buffer **ringbuffer_output;     //One per channel
 
-  void *resampler_output;
-  float_buffer *ringbuffer_output;
+  bool *drop_next_frame;        //One per channel; used by process_frames
+  bool *drop_requested;         //One per channel; applied to drop_next_frame when the next frames are processed
 
-  bool drop_next_frame;
+  bool worker;                  //Worker mode requested (applied on DSP start)
+  bool worker_active;           //Worker mode is used (worker_pool acquired)
+  t_worker_job job;             //Processes job_frames frames (per channel) stored in frames and adds them to handoff
+  unsigned int job_frames;
+  float_buffer_spsc **handoff;  //One per channel (worker mode); producer: the job, consumer: the DSP-thread
 
-  float *frame_last_decoded;    //Contains the last encoded and decoded frame (sample_rate_internal); used for packet loss concealment
+  t_generic_codec_apply_settings apply_settings;        //Optional (NULL)
+  bool settings_requested;      //Set by generic_codec_request_settings(); applied when the next frames are processed
 
-  t_outlet *outlet;
+  bool error_pending;           //Set by generic_codec_error(); reported after the frames were processed
+  char error_message[MAXPDSTRING];
+
+  float *scratch;               //Preallocated memory for the DSP-thread (channels x block_size)
+  float *frames;                //Preallocated memory for the DSP-thread (channels x frames_max x frame_size)
+  float *collected;             //Preallocated memory for the DSP-thread (channels x frames_max x frame_size; worker mode); drained from handoff
+  float **src_channels;         //Preallocated memory for the DSP-thread (channels); source pointers for the resamplers
+  float **dst_channels;         //Preallocated memory for the DSP-thread (channels); destination pointers for the resamplers
+
+  int phase_requested;          //Phase (samples; sample_rate_internal) or GENERIC_CODEC_PHASE_AUTOMATIC
+  unsigned int phase_index;     //Round-robin index (GENERIC_CODEC_PHASE_AUTOMATIC)
+  unsigned int phase;           //Silence added to ringbuffer_input on DSP start (samples; sample_rate_internal)
+
+  unsigned int delay;           //Delay added by the external (samples; sample_rate_internal); set before generic_codec_dsp_add()
+
+  unsigned int prefill;         //Silence added to ringbuffer_output on DSP start (samples; sample_rate_external)
+  unsigned int underrun;        //Samples output as silence due to an empty ringbuffer_output; skipped as soon as available (samples; sample_rate_external)
+  double latency;               //Total latency (samples; sample_rate_external); negative if the DSP was not started yet
+
+  t_outlet **outlets;           //One per channel
 } t_generic_codec;
 
-static inline void generic_codec_init (t_generic_codec * codec, t_object * obj, float sample_rate_internal, unsigned int frame_size) {
+//Reports an error of process_frames (printf-style); only the first error per DSP tick is reported.
+static inline void generic_codec_error (t_generic_codec * codec, const char *format, ...) {
+  if (codec->error_pending) {
+    return;
+  }
+
+  va_list arguments;
+  va_start (arguments, format);
+  vsnprintf (codec->error_message, MAXPDSTRING, format, arguments);
+  va_end (arguments);
+  codec->error_pending = true;
+}
+
+//Passes the frames of each channel to process_frames (helper function).
+static inline void generic_codec_process_frames (t_generic_codec * codec, unsigned int frames) {
+  for (unsigned int channel = 0; channel < codec->channels; channel++) {
+    codec->process_frames (codec->owner, channel, frames, &codec->frames[channel * codec->frames_max * codec->frame_size]);
+  }
+}
+
+//Job executed by the worker pool: processes the frames and adds them to handoff (helper function).
+static void generic_codec_run_job (t_generic_codec * codec) {
+  generic_codec_process_frames (codec, codec->job_frames);
+
+  for (unsigned int channel = 0; channel < codec->channels; channel++) {
+    if (!float_buffer_spsc_add_chunk (codec->handoff[channel], &codec->frames[channel * codec->frames_max * codec->frame_size], codec->job_frames * codec->frame_size)) {
+      generic_codec_error (codec, "generic_codec: worker output dropped (handoff full).");
+    }
+  }
+}
+
+//Creates the inlets (except the main signal inlet) and outlets (one per channel).
+static inline void generic_codec_init (t_generic_codec * codec, t_object * obj, float sample_rate_internal, unsigned int frame_size, unsigned int resampler_quality, unsigned int channels, t_generic_codec_process_frames process_frames) {
   codec->sample_rate_internal = sample_rate_internal;
+  codec->channels = channels;
   codec->frame_size = frame_size;
+  codec->frames_max = 0;
+  codec->resampler_quality = resampler_quality;
+
+  codec->process_frames = process_frames;
+  codec->owner = obj;
 
   codec->resampler_input = NULL;
-  codec->ringbuffer_input = NULL;
+  codec->ringbuffer_input = calloc (channels, sizeof (float_buffer *));
 
   codec->resampler_output = NULL;
-  codec->ringbuffer_output = NULL;
+  codec->ringbuffer_output = calloc (channels, sizeof (float_buffer *));
+
+  codec->drop_next_frame = calloc (channels, sizeof (bool));
+  codec->drop_requested = calloc (channels, sizeof (bool));
+
+  codec->worker = false;
+  codec->worker_active = false;
+  worker_job_init (&codec->job, (t_worker_job_function) generic_codec_run_job, codec);
+  codec->job_frames = 0;
+  codec->handoff = calloc (channels, sizeof (float_buffer_spsc *));
+
+  codec->apply_settings = NULL;
+  codec->settings_requested = false;
+
+  codec->error_pending = false;
+
+  codec->scratch = NULL;
+  codec->frames = NULL;
+  codec->collected = NULL;
+  codec->src_channels = calloc (channels, sizeof (float *));
+  codec->dst_channels = calloc (channels, sizeof (float *));
+
+  codec->phase_requested = GENERIC_CODEC_PHASE_AUTOMATIC;
+  codec->phase_index = generic_codec_phase_counter++;
+  codec->phase = 0;
+
+  codec->delay = 0;
 
-  codec->outlet = outlet_new (obj, &s_signal);
+  codec->prefill = 0;
+  codec->underrun = 0;
+  codec->latency = -1;
+
+  for (unsigned int channel = 1; channel < channels; channel++) {
+    inlet_new (obj, &obj->ob_pd, &s_signal, &s_signal);
+  }
+
+  codec->outlets = calloc (channels, sizeof (t_outlet *));
+  for (unsigned int channel = 0; channel < channels; channel++) {
+    codec->outlets[channel] = outlet_new (obj, &s_signal);
+  }
 }
 
-static inline void generic_codec_free_internal (t_generic_codec * codec) {
+//Frees the resamplers (helper function).
+static inline void generic_codec_free_resampler (t_generic_codec * codec) {
   if (codec->resampler_input != NULL) {
-    resample_close (codec->resampler_input);
-  }
-  if (codec->ringbuffer_input != NULL) {
-    float_buffer_free (codec->ringbuffer_input);
+    resampler_close (codec->resampler_input);
+    codec->resampler_input = NULL;
   }
-  free (codec->ringbuffer_input);
 
   if (codec->resampler_output != NULL) {
-    resample_close (codec->resampler_output);
+    resampler_close (codec->resampler_output);
+    codec->resampler_output = NULL;
   }
-  if (codec->ringbuffer_output != NULL) {
-    float_buffer_free (codec->ringbuffer_output);
+}
+
+//Frees all memory that depends on the block size (helper function).
+static inline void generic_codec_free_internal (t_generic_codec * codec) {
+  for (unsigned int channel = 0; channel < codec->channels; channel++) {
+    if (codec->ringbuffer_input[channel] != NULL) {
+      float_buffer_free (codec->ringbuffer_input[channel]);
+    }
+    free (codec->ringbuffer_input[channel]);
+    codec->ringbuffer_input[channel] = NULL;
+
+    if (codec->ringbuffer_output[channel] != NULL) {
+      float_buffer_free (codec->ringbuffer_output[channel]);
+    }
+    free (codec->ringbuffer_output[channel]);
+    codec->ringbuffer_output[channel] = NULL;
+
+    if (codec->handoff[channel] != NULL) {
+      float_buffer_spsc_free (codec->handoff[channel]);
+      codec->handoff[channel] = NULL;
+    }
   }
-  free (codec->ringbuffer_output);
 
-  free (codec->frame_last_decoded);
+  free (codec->scratch);
+  codec->scratch = NULL;
+
+  free (codec->frames);
+  codec->frames = NULL;
+
+  free (codec->collected);
+  codec->collected = NULL;
 }
 
 static inline void generic_codec_free (t_generic_codec * codec) {
-  outlet_free (codec->outlet);
+  if (codec->worker_active) {
+    worker_job_cancel (&codec->job);
+    worker_pool_release ();
+  }
+  worker_job_destroy (&codec->job);
+
+  for (unsigned int channel = 0; channel < codec->channels; channel++) {
+    outlet_free (codec->outlets[channel]);
+  }
+  free (codec->outlets);
+
+  generic_codec_free_resampler (codec);
   generic_codec_free_internal (codec);
+
+  free (codec->ringbuffer_input);
+  free (codec->ringbuffer_output);
+  free (codec->handoff);
+  free (codec->drop_next_frame);
+  free (codec->drop_requested);
+  free (codec->src_channels);
+  free (codec->dst_channels);
 }
 
+//Adds silence to the ringbuffer (helper function).
+static inline void generic_codec_add_silence (float_buffer * buffer, unsigned int n) {
+  while (n > 0) {
+    float *region;
+    unsigned int region_size = float_buffer_free_region (buffer, &region);
+    if (region_size > n) {
+      region_size = n;
+    }
+    memset (region, 0, sizeof (float) * region_size);
+    float_buffer_commit (buffer, region_size);
+    n -= region_size;
+  }
+}
+
+//Drops the next frame of all channels.
+static inline void generic_codec_drop_next_frame (t_generic_codec * codec) {
+  for (unsigned int channel = 0; channel < codec->channels; channel++) {
+    codec->drop_requested[channel] = true;
+  }
+}
+
+//Enables or disables worker mode (for the method "worker"); applied on the next DSP start (the latency changes).
+static inline void generic_codec_set_worker (t_generic_codec * codec, const char *name, bool worker) {
+  if (codec->worker == worker) {
+    return;
+  }
+  codec->worker = worker;
+  post ("%s: worker threads %s (applied on the next DSP start).", name, worker ? "enabled" : "disabled");
+}
+
+//Sets the phase (for the method "phase"); negative: automatic (round-robin). Applied on the next DSP start.
+static inline void generic_codec_set_phase (t_generic_codec * codec, const char *name, int phase) {
+  if (phase < 0) {
+    phase = GENERIC_CODEC_PHASE_AUTOMATIC;
+  }
+  if (phase >= (int) codec->frame_size) {
+    error ("%s: invalid phase specified (%d). Using %d.", name, phase, phase % codec->frame_size);
+    phase = phase % codec->frame_size;
+  }
+  if (codec->phase_requested == phase) {
+    return;
+  }
+  codec->phase_requested = phase;
+  post ("%s: phase changed (applied on the next DSP start).", name);
+}
+
+//Requests to apply the settings (callback apply_settings) before the next frames are processed.
+static inline void generic_codec_request_settings (t_generic_codec * codec) {
+  codec->settings_requested = true;
+}
+
+//Posts the error of process_frames (DSP-thread; helper function).
+static inline void generic_codec_report_error (t_generic_codec * codec) {
+  if (codec->error_pending) {
+    error ("%s", codec->error_message);
+    codec->error_pending = false;
+  }
+}
+
+//Stops the processing on DSP (re)start (cancels the job of the worker threads); call before the codec state used by process_frames is reset.
+static inline void generic_codec_dsp_stop (t_generic_codec * codec) {
+  if (codec->worker_active) {
+    worker_job_cancel (&codec->job);
+  }
+  codec->job_frames = 0;
+}
+
+/**
+ * Allocates all buffers and adds the perform-routine f.
+ *
+ * Arguments of f: w[1] = x, w[2] = block size, w[3...] = inlets (channels), w[3 + channels...] = outlets (channels).
+ */
 static inline void generic_codec_dsp_add (t_generic_codec * codec, unsigned int block_size, void *x, t_perfroutine f, t_signal ** sp) {
+  generic_codec_dsp_stop (codec);
+  codec->error_pending = false;
+
+  if (codec->worker && !codec->worker_active) {
+    codec->worker_active = worker_pool_acquire ();
+    if (!codec->worker_active) {
+      error ("generic_codec: worker threads could not be started; processing on the DSP-thread.");
+    }
+  } else if (!codec->worker && codec->worker_active) {
+    worker_pool_release ();
+    codec->worker_active = false;
+  }
+
   generic_codec_free_internal (codec);
 
   codec->sample_rate_external = sys_getsr ();
 
-  double factor_in = (double) (codec->sample_rate_internal / codec->sample_rate_external);
-  codec->resampler_input = resample_open (1, factor_in, factor_in);
+  if (codec->resampler_input != NULL && resampler_matches (codec->resampler_input, codec->sample_rate_external, codec->sample_rate_internal, codec->resampler_quality, codec->channels)) {
+    resampler_reset (codec->resampler_input);
+    resampler_reset (codec->resampler_output);
+  } else {
+    generic_codec_free_resampler (codec);
+    codec->resampler_input = resampler_open (codec->sample_rate_external, codec->sample_rate_internal, codec->resampler_quality, codec->channels);
+    codec->resampler_output = resampler_open (codec->sample_rate_internal, codec->sample_rate_external, codec->resampler_quality, codec->channels);
+  }
 
   double factor_out = (double) (codec->sample_rate_external / codec->sample_rate_internal);
-  codec->resampler_output = resample_open (1, factor_out, factor_out);
 
-  //Buffers are allocated with a maximum of three times the INPUT block size
-  codec->ringbuffer_input = float_buffer_alloc (codec->frame_size * 3, codec->frame_size);
-  int output_size = (codec->frame_size * factor_out + .5) * 3;
-  codec->ringbuffer_output = float_buffer_alloc (output_size, block_size);
+  if (codec->phase_requested == GENERIC_CODEC_PHASE_AUTOMATIC) {
+    codec->phase = (codec->phase_index * (unsigned int) ceil (block_size / factor_out)) % codec->frame_size;
+  } else {
+    codec->phase = codec->phase_requested;
+  }
 
-  codec->drop_next_frame = false;
+  //Waiting for a complete frame (plus rounding of both resamplers) must be covered by the prefill; the phase already covers a part of it
+  codec->prefill = ceil (codec->frame_size * factor_out + factor_out) + 2 - (unsigned int) floor (codec->phase * factor_out);
+  if (codec->worker_active) {
+    //A job may take one frame (rounded up to complete blocks); its output is drained in the next DSP tick (one block)
+    codec->prefill += (unsigned int) ceil (ceil (codec->frame_size * factor_out) / block_size) * block_size + block_size;
+  }
+  codec->underrun = 0;
+  codec->latency = codec->prefill + (codec->phase + codec->delay) * factor_out + (resampler_delay (codec->resampler_input) + resampler_delay (codec->resampler_output)) * codec->sample_rate_external;
+
+  //One DSP tick completes at most frames_max frames (incl. rounding of resampler_input)
+  unsigned int block_size_internal = ceil (block_size / factor_out) + 1;
+  codec->frames_max = (block_size_internal + codec->frame_size - 1) / codec->frame_size + 1;
+
+  //Worker mode: ringbuffer_input also holds the frames completed while a job is running
+  unsigned int input_frames = codec->worker_active ? 4 * codec->frames_max : codec->frames_max + 1;
+  int output_size = codec->prefill + (codec->frames_max * codec->frame_size * factor_out + 2) + block_size * 2;
+  for (unsigned int channel = 0; channel < codec->channels; channel++) {
+    codec->ringbuffer_input[channel] = float_buffer_alloc (input_frames * codec->frame_size, codec->frame_size);
+    generic_codec_add_silence (codec->ringbuffer_input[channel], codec->phase);
+    codec->ringbuffer_output[channel] = float_buffer_alloc (output_size, block_size);
+    generic_codec_add_silence (codec->ringbuffer_output[channel], codec->prefill);
+
+    codec->drop_next_frame[channel] = false;
+    codec->drop_requested[channel] = false;
+  }
 
-  codec->frame_last_decoded = calloc (block_size, sizeof (codec->frame_last_decoded));
+  codec->scratch = calloc (codec->channels * block_size, sizeof (float));
+  codec->frames = calloc (codec->channels * codec->frames_max * codec->frame_size, sizeof (float));
+
+  if (codec->worker_active) {
+    codec->collected = calloc (codec->channels * codec->frames_max * codec->frame_size, sizeof (float));
+    for (unsigned int channel = 0; channel < codec->channels; channel++) {
+      codec->handoff[channel] = float_buffer_spsc_alloc (2 * codec->frames_max * codec->frame_size);
+      if (codec->handoff[channel] == NULL) {
+        error ("generic_codec: worker threads could not be used (out of memory); processing on the DSP-thread.");
+        worker_pool_release ();
+        codec->worker_active = false;
+        break;
+      }
+    }
+  }
 
-  t_int signal_ref[4];
+  t_int signal_ref[2 + 2 * GENERIC_CODEC_CHANNELS_MAX];
   signal_ref[0] = (t_int) x;
-  signal_ref[1] = (t_int) sp[0]->s_vec;
-  signal_ref[2] = (t_int) sp[1]->s_vec;
-  signal_ref[3] = (t_int) sp[0]->s_n;
+  signal_ref[1] = (t_int) sp[0]->s_n;
+  for (unsigned int i = 0; i < 2 * codec->channels; i++) {
+    signal_ref[2 + i] = (t_int) sp[i]->s_vec;
+  }
+
+  dsp_addv (f, 2 + 2 * codec->channels, signal_ref);
+}
 
-  dsp_addv (f, 4, signal_ref);
+//Resamples all channels directly into the free region(s) of the ringbuffers (helper function).
+static inline void generic_codec_resample_into_buffer (t_generic_codec * codec, t_resampler * resampler, float_buffer ** buffers, unsigned int n, float *src, unsigned int src_stride) {
+  unsigned int src_idx = 0;
+  unsigned int dst_size;
+  unsigned int region_size;
+  do {
+    for (unsigned int channel = 0; channel < codec->channels; channel++) {
+      region_size = float_buffer_free_region (buffers[channel], &codec->dst_channels[channel]);        //Same for all channels (lockstep)
+      codec->src_channels[channel] = &src[channel * src_stride + src_idx];
+    }
+
+    unsigned int src_used;
+    dst_size = do_resample_into (n - src_idx, codec->src_channels, resampler, codec->dst_channels, region_size, &src_used);
+    for (unsigned int channel = 0; channel < codec->channels; channel++) {
+      float_buffer_commit (buffers[channel], dst_size);
+    }
+
+    src_idx += src_used;
+
+    if (src_used == 0 && dst_size == 0) {
+      break;                    //Nothing left to resample
+    }
+  } while (src_idx < n || dst_size == region_size);
 }
 
-static inline void generic_codec_resample_to_internal (t_generic_codec * codec, unsigned int n, t_sample * in) {
-  float buffer[n];
-  for (int i = 0; i < n; i++) {
-    buffer[i] = in[i];
+//Resamples the inlets (in[channel]) to the internal sample rate.
+static inline void generic_codec_resample_to_internal (t_generic_codec * codec, unsigned int n, t_sample ** in) {
+  for (unsigned int channel = 0; channel < codec->channels; channel++) {
+    float *scratch = &codec->scratch[channel * n];
+    for (unsigned int i = 0; i < n; i++) {
+      scratch[i] = in[channel][i];
+    }
   }
 
-  unsigned int input_size;
-  float *input = do_resample (n, buffer, codec->resampler_input, (double) (codec->sample_rate_internal / codec->sample_rate_external), &input_size);
-  float_buffer_add_chunk (codec->ringbuffer_input, input, input_size);
+  generic_codec_resample_into_buffer (codec, codec->resampler_input, codec->ringbuffer_input, n, codec->scratch, n);
+}
 
-  free (input);
+//Resamples n samples per channel (channel i starts at out_chunks[i * stride]) to the external sample rate; afterwards, samples are skipped to compensate an underrun.
+static inline void generic_codec_resample_to_external (t_generic_codec * codec, unsigned int n, float *out_chunks, unsigned int stride) {
+  generic_codec_resample_into_buffer (codec, codec->resampler_output, codec->ringbuffer_output, n, out_chunks, stride);
+
+  if (codec->underrun > 0) {
+    unsigned int skip = codec->ringbuffer_output[0]->number_elements;
+    if (skip > codec->underrun) {
+      skip = codec->underrun;
+    }
+    for (unsigned int channel = 0; channel < codec->channels; channel++) {
+      float_buffer_skip (codec->ringbuffer_output[channel], skip);
+    }
+    codec->underrun -= skip;
+  }
 }
 
-static inline void generic_codec_resample_to_external (t_generic_codec * codec, unsigned int n, float *out_chunk) {
-  unsigned int output_size;
-  float *output = do_resample (n, out_chunk, codec->resampler_output, (double) (codec->sample_rate_external / codec->sample_rate_internal), &output_size);
-  float_buffer_add_chunk (codec->ringbuffer_output, output, output_size);
-  free (output);
+//Outputs one block per channel; silence if not enough samples are available (should not happen due to the prefill; worker mode: a job took too long).
+static inline void generic_codec_to_outbuffer (t_generic_codec * codec, t_sample ** out) {
+  if (!float_buffer_has_chunk (codec->ringbuffer_output[0])) {
+    for (unsigned int channel = 0; channel < codec->channels; channel++) {
+      for (unsigned int i = 0; i < codec->ringbuffer_output[channel]->chunk_size; i++) {
+        out[channel][i] = 0;
+      }
+    }
+    codec->underrun += codec->ringbuffer_output[0]->chunk_size;
+    return;
+  }
+
+  for (unsigned int channel = 0; channel < codec->channels; channel++) {
+    float_buffer *buffer = codec->ringbuffer_output[channel];
+
+    float_buffer_pop_chunk_to (buffer, codec->scratch, buffer->chunk_size);
+    for (unsigned int i = 0; i < buffer->chunk_size; i++) {
+      out[channel][i] = codec->scratch[i];
+    }
+  }
+}
+
+//Moves all complete frames of each channel to codec->frames (channel i starts at codec->frames[i * codec->frames_max * codec->frame_size]); returns the number of frames per channel (helper function).
+static inline unsigned int generic_codec_pop_frames (t_generic_codec * codec) {
+  unsigned int frames = codec->ringbuffer_input[0]->number_elements / codec->frame_size;
+  if (frames > codec->frames_max) {
+    frames = codec->frames_max;
+  }
+  if (frames == 0) {
+    return 0;
+  }
+
+  for (unsigned int channel = 0; channel < codec->channels; channel++) {
+    float_buffer_pop_chunk_to (codec->ringbuffer_input[channel], &codec->frames[channel * codec->frames_max * codec->frame_size], frames * codec->frame_size);
+
+    if (codec->drop_requested[channel]) {
+      codec->drop_next_frame[channel] = true;
+      codec->drop_requested[channel] = false;
+    }
+  }
+
+  if (codec->settings_requested && codec->apply_settings != NULL) {
+    codec->apply_settings (codec->owner);
+    codec->settings_requested = false;
+  }
+  return frames;
 }
 
-static inline void generic_codec_to_outbuffer (t_generic_codec * codec, t_sample * out) {
-  bool manual = false;
-  float *out_chunk;
-  float_buffer_pop_chunk (codec->ringbuffer_output, &out_chunk, codec->ringbuffer_output->chunk_size, &manual);
+/**
+ * Resamples the input and passes all complete frames of each channel to process_frames.
+ * The processed frames of channel i start at codec->frames[i * codec->frames_max * codec->frame_size].
+ *
+ * @return Number of processed samples per channel (multiple of frame_size).
+ */
+static inline unsigned int generic_codec_process_input (t_generic_codec * codec, unsigned int n, t_sample ** in) {
+  generic_codec_resample_to_internal (codec, n, in);
+
+  unsigned int frames = generic_codec_pop_frames (codec);
+  if (frames == 0) {
+    return 0;
+  }
+
+  generic_codec_process_frames (codec, frames);
+  generic_codec_report_error (codec);
+  return frames * codec->frame_size;
+}
 
-  for (int i = 0; i < codec->ringbuffer_output->chunk_size; i++) {
-    out[i] = out_chunk[i];
+//Worker mode: drains the processed frames from handoff (same number of samples for all channels) and resamples them to the external sample rate (helper function).
+static inline void generic_codec_drain_handoff (t_generic_codec * codec) {
+  unsigned int n = float_buffer_spsc_number_elements (codec->handoff[0]);
+  for (unsigned int channel = 1; channel < codec->channels; channel++) {
+    unsigned int available = float_buffer_spsc_number_elements (codec->handoff[channel]);
+    if (available < n) {
+      n = available;            //The job may still be adding the frames of this channel
+    }
   }
 
-  if (manual) {
-    free (out_chunk);
+  unsigned int stride = codec->frames_max * codec->frame_size;
+  while (n > 0) {
+    unsigned int size = n < stride ? n : stride;
+    for (unsigned int channel = 0; channel < codec->channels; channel++) {
+      float_buffer_spsc_pop_chunk_to (codec->handoff[channel], &codec->collected[channel * stride], size);
+    }
+    generic_codec_resample_to_external (codec, size, codec->collected, stride);
+    n -= size;
+  }
+}
+
+//Worker mode: drains the output of the previous job and, if it is done, submits the frames completed so far as new job; never waits for a job (helper function).
+static inline void generic_codec_process_input_worker (t_generic_codec * codec, unsigned int n, t_sample ** in) {
+  generic_codec_resample_to_internal (codec, n, in);
+
+  generic_codec_drain_handoff (codec);
+
+  if (!worker_job_collect (&codec->job)) {
+    return;                     //Still running: the frames remain in ringbuffer_input
+  }
+  generic_codec_report_error (codec);
+
+  codec->job_frames = generic_codec_pop_frames (codec);
+  if (codec->job_frames > 0) {
+    worker_job_submit (&codec->job);
+  }
+}
+
+//Generic perform-routine: w[1] must be the t_generic_codec.
+static inline t_int *generic_codec_perform (t_int * w) {
+  t_generic_codec *codec = (t_generic_codec *) (w[1]);
+  int n = (int) (w[2]);
+  t_sample **in = (t_sample **) & w[3];
+  t_sample **out = (t_sample **) & w[3 + codec->channels];
+
+  if (codec->worker_active) {
+    generic_codec_process_input_worker (codec, n, in);
+  } else {
+    unsigned int processed = generic_codec_process_input (codec, n, in);
+    if (processed > 0) {
+      generic_codec_resample_to_external (codec, processed, codec->frames, codec->frames_max * codec->frame_size);
+    }
+  }
+
+  generic_codec_to_outbuffer (codec, out);
+
+  return (w + 3 + 2 * codec->channels);
+}
+
+//Posts the latency (for the method "latency").
+static inline void generic_codec_post_latency (t_generic_codec * codec, const char *name) {
+  if (codec->latency < 0) {
+    post ("%s: latency unknown (DSP was not started yet).", name);
+    return;
   }
+  post ("%s: latency %.3fms (%.1f samples; prefill %u samples; phase %u samples; delay %u samples%s).", name, 1000 * codec->latency / codec->sample_rate_external, codec->latency, codec->prefill, codec->phase, codec->delay, codec->worker_active ? "; worker threads" : "");
 }
 #endif
@@ -0,0 +1,104 @@
+/**
+@file gsm_plc.h
+@author Frank Haase, Dennis Guse
+@date 2026-10-16
+@license GPLv3 or later
+
+Substitution and muting of lost frames for GSM 06.10 (libgsm) similar to the example solution of GSM 06.11.
+
+The parameters of the last received frame are stored (gsm_explode()); for a lost frame a substitute frame is decoded (gsm_implode()):
+  First lost frame: the last received frame is repeated.
+  Subsequent lost frames: LARs and LTP parameters (lag and gain) are repeated, the RPE pulses are random and the block amplitude (xmaxc) is reduced by 4 per frame (approx. 3dB).
+  After GSM_PLC_MUTE lost frames (320ms) the output is muted; the decoder still decodes a frame of minimal amplitude (block amplitude and LTP gain set to zero).
+As the substitute frame is decoded, the state of the decoder follows the concealed signal.
+
+Developer note: parameter layout of gsm_explode(): 8 LARs, then per sub-frame (17 parameters) Nc, bc, Mc, xmaxc and 13 xmc.
+Developer note: without a received frame, lost frames are decoded as silence.
+
+@see g711_plc.h
+*/
+
+#ifndef GSM_PLC_H_
+#define GSM_PLC_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <gsm.h>
+
+#define GSM_PLC_PARAMETERS 76
+#define GSM_PLC_LAR 8
+#define GSM_PLC_SUBFRAMES 4
+#define GSM_PLC_SUBFRAME_PARAMETERS 17
+#define GSM_PLC_BC 1            //Offset in sub-frame: LTP gain
+#define GSM_PLC_XMAXC 3         //Offset in sub-frame: block amplitude
+#define GSM_PLC_XMC 4           //Offset in sub-frame: RPE pulses (13)
+#define GSM_PLC_XMC_SIZE 13
+
+#define GSM_PLC_ATTENUATION 4   //Reduction of xmaxc per lost frame
+#define GSM_PLC_MUTE 16         //Lost frames until muted
+
+typedef struct _gsm_plc {
+  gsm_signal parameters[GSM_PLC_PARAMETERS];    //Last received frame
+  bool received;                //A frame was received
+
+  unsigned int erased;          //Lost frames in a row
+
+  uint32_t random;              //State of the random number generator (xorshift)
+} t_gsm_plc;
+
+static void gsm_plc_init (t_gsm_plc * plc, uint32_t seed) {
+  memset (plc, 0, sizeof (t_gsm_plc));
+  plc->random = seed != 0 ? seed : 1;
+}
+
+//Returns a uniformly distributed random number (32 bit; xorshift).
+static inline uint32_t gsm_plc_random (t_gsm_plc * plc) {
+  plc->random ^= plc->random << 13;
+  plc->random ^= plc->random >> 17;
+  plc->random ^= plc->random << 5;
+  return plc->random;
+}
+
+//Stores the parameters of a received frame.
+static void gsm_plc_receive (t_gsm_plc * plc, gsm decoder, gsm_byte * encoded) {
+  gsm_explode (decoder, encoded, plc->parameters);
+  plc->received = true;
+  plc->erased = 0;
+}
+
+//Creates the substitute frame for a lost frame (to be decoded); returns false if the output must be muted (the decoded frame only updates the state of the decoder).
+static bool gsm_plc_conceal (t_gsm_plc * plc, gsm decoder, gsm_byte * encoded) {
+  if (plc->erased <= GSM_PLC_MUTE) {
+    plc->erased++;
+  }
+
+  gsm_signal parameters[GSM_PLC_PARAMETERS];
+  memcpy (parameters, plc->parameters, sizeof (parameters));
+
+  bool muted = !plc->received || plc->erased > GSM_PLC_MUTE;
+  if (muted) {
+    for (unsigned int subframe = 0; subframe < GSM_PLC_SUBFRAMES; subframe++) {
+      gsm_signal *p = &parameters[GSM_PLC_LAR + subframe * GSM_PLC_SUBFRAME_PARAMETERS];
+      p[GSM_PLC_BC] = 0;
+      p[GSM_PLC_XMAXC] = 0;
+      for (unsigned int i = 0; i < GSM_PLC_XMC_SIZE; i++) {
+        p[GSM_PLC_XMC + i] = 3 + (i & 1);       //Smallest pulses
+      }
+    }
+  } else if (plc->erased > 1) {
+    int attenuation = (plc->erased - 1) * GSM_PLC_ATTENUATION;
+    for (unsigned int subframe = 0; subframe < GSM_PLC_SUBFRAMES; subframe++) {
+      gsm_signal *p = &parameters[GSM_PLC_LAR + subframe * GSM_PLC_SUBFRAME_PARAMETERS];
+      p[GSM_PLC_XMAXC] = p[GSM_PLC_XMAXC] > attenuation ? p[GSM_PLC_XMAXC] - attenuation : 0;
+      for (unsigned int i = 0; i < GSM_PLC_XMC_SIZE; i++) {
+        p[GSM_PLC_XMC + i] = gsm_plc_random (plc) >> 29;       //3 bit
+      }
+    }
+  }
+
+  gsm_implode (decoder, parameters, encoded);
+  return !muted;
+}
+
+#endif /* GSM_PLC_H_ */
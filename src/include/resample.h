@@ -4,57 +4,433 @@
 @date 2016-08-24
 @license GPLv3 or later
 
-Helper function for libresample to resample the complete signal.
-Resample the source signal by individual blocks (src_blocksize).
+Polyphase resampler for rational ratios (rate_out / rate_in = up / down).
+
+The filter (Kaiser-windowed sinc) is split into `up` phases of `taps` coefficients each.
+For each output sample only one phase is applied to the last `taps` input samples.
+The coefficients are precomputed once per (rate_in, rate_out, quality) and shared by all resamplers of an external (reference counted).
+
+Developer note: the history of the input signal is stored twice back-to-back, so the last `taps` input samples are always contiguous.
+Developer note: a resampler processes one or more channels in one pass; all channels share the table and the phase (structure of arrays).
+Developer note: the coefficient cache is not thread-safe; resamplers must be opened and closed by the same thread (i.e., PureData's main thread).
+Developer note: PureData loads each external as separate shared object, so every external has its own coefficient cache.
+
+Quality (trades latency and CPU for stopband attenuation and passband width):
+  RESAMPLER_QUALITY_MEDIUM: 16 taps per phase [default]
+  RESAMPLER_QUALITY_LOW: 8 taps per phase (low latency)
+  RESAMPLER_QUALITY_HIGH: 32 taps per phase
+
+For downsampling the number of taps is multiplied by the ratio (down / up).
+
+Special cases (selected automatically by the ratio):
+  Identity (rate_in == rate_out): the signal is copied (no filter, no latency).
+  Integer decimation (up == 1): only one phase exists; `down` input samples are added per output sample.
+  Integer interpolation (down == 1): all `up` phases are applied to each input sample in order.
 
 */
 
 #ifndef RESAMPLE_H_
 #define RESAMPLE_H_
 
-#include <libresample.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define RESAMPLER_QUALITY_MEDIUM 0
+#define RESAMPLER_QUALITY_LOW 1
+#define RESAMPLER_QUALITY_HIGH 2
+
+typedef struct _resampler_table {
+  unsigned int rate_in;
+  unsigned int rate_out;
+  unsigned int quality;
+
+  unsigned int up;              //Interpolation factor (also number of phases)
+  unsigned int down;            //Decimation factor
+
+  unsigned int taps;            //Coefficients per phase (multiple of 4)
+  float *coefficients;          //up x taps; the coefficients of one phase are ordered from the newest to the oldest input sample
+
+  unsigned int references;      //Number of resamplers using this table
+
+  struct _resampler_table *next;
+} t_resampler_table;
+
+typedef struct _resampler {
+  t_resampler_table *table;
+
+  unsigned int channels;
+
+  float *history;               //channels x 2 x taps: last input samples (stored twice)
+  unsigned int history_index;   //Index of the newest input sample (same for all channels)
+
+  unsigned int phase;           //Position of the next output sample relative to the newest input sample (in units of 1/up input samples); >= up if the next input sample is required
+} t_resampler;
+
+//All coefficient tables of this external
+static t_resampler_table *resampler_tables = NULL;
+
+//Greatest common divisor (helper function).
+static unsigned int resampler_gcd (unsigned int a, unsigned int b) {
+  while (b != 0) {
+    unsigned int t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+//Modified Bessel function of the first kind, order zero (helper function).
+static double resampler_bessel_i0 (double x) {
+  double sum = 1, term = 1;
+  for (int k = 1; k < 50 && term > sum * 1e-12; k++) {
+    term *= (x / (2 * k)) * (x / (2 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+//Returns the coefficients for the requested rates and quality; these are only computed if not yet in use (helper function).
+static t_resampler_table *resampler_table_get (unsigned int rate_in, unsigned int rate_out, unsigned int quality) {
+  if (quality != RESAMPLER_QUALITY_LOW && quality != RESAMPLER_QUALITY_HIGH) {
+    quality = RESAMPLER_QUALITY_MEDIUM;
+  }
+
+  for (t_resampler_table * table = resampler_tables; table != NULL; table = table->next) {
+    if (table->rate_in == rate_in && table->rate_out == rate_out && table->quality == quality) {
+      table->references++;
+      return table;
+    }
+  }
+
+  unsigned int taps_per_phase;
+  double beta, rolloff;
+  switch (quality) {
+  case RESAMPLER_QUALITY_LOW:
+    taps_per_phase = 8;
+    beta = 5;
+    rolloff = 0.80;
+    break;
+  case RESAMPLER_QUALITY_HIGH:
+    taps_per_phase = 32;
+    beta = 9;
+    rolloff = 0.94;
+    break;
+  default:
+    taps_per_phase = 16;
+    beta = 7;
+    rolloff = 0.90;
+  }
+
+  t_resampler_table *table = malloc (sizeof (t_resampler_table));
+  if (table == NULL) {
+    return NULL;
+  }
+  table->rate_in = rate_in;
+  table->rate_out = rate_out;
+  table->quality = quality;
+
+  unsigned int divisor = resampler_gcd (rate_in, rate_out);
+  table->up = rate_out / divisor;
+  table->down = rate_in / divisor;
+
+  //Identity: no filter required
+  if (table->up == table->down) {
+    table->taps = 0;
+    table->coefficients = NULL;
+
+    table->references = 1;
+    table->next = resampler_tables;
+    resampler_tables = table;
+    return table;
+  }
+
+  //Downsampling: the filter must cover down / up more input samples
+  table->taps = taps_per_phase;
+  if (table->down > table->up) {
+    table->taps = (taps_per_phase * table->down + table->up - 1) / table->up;
+  }
+  table->taps = (table->taps + 3) & ~3u;
 
-#define MIN(A, B) (A) < (B)? (A) : (B)
+  table->coefficients = malloc (sizeof (float) * table->up * table->taps);
+  if (table->coefficients == NULL) {
+    free (table);
+    return NULL;
+  }
+
+  //Prototype filter at the upsampled rate: cutoff at the lower Nyquist frequency and gain `up` (compensates zero insertion)
+  unsigned int length = table->up * table->taps;
+  double cutoff = rolloff * 0.5 / (table->up > table->down ? table->up : table->down);
+  double center = (length - 1) / 2.;
+  for (unsigned int phase = 0; phase < table->up; phase++) {
+    for (unsigned int tap = 0; tap < table->taps; tap++) {
+      unsigned int n = phase + tap * table->up;
+      double t = n - center;
+      double sinc = t == 0 ? 1 : sin (2 * M_PI * cutoff * t) / (2 * M_PI * cutoff * t);
+      double window = resampler_bessel_i0 (beta * sqrt (fmax (0, 1 - (t / center) * (t / center)))) / resampler_bessel_i0 (beta);
+      table->coefficients[phase * table->taps + tap] = table->up * 2 * cutoff * sinc * window;
+    }
+  }
+
+  table->references = 1;
+  table->next = resampler_tables;
+  resampler_tables = table;
+  return table;
+}
+
+//Releases the coefficients; these are freed if no other resampler uses them (helper function).
+static void resampler_table_release (t_resampler_table * table) {
+  table->references--;
+  if (table->references > 0) {
+    return;
+  }
+
+  for (t_resampler_table ** entry = &resampler_tables; *entry != NULL; entry = &(*entry)->next) {
+    if (*entry == table) {
+      *entry = table->next;
+      break;
+    }
+  }
+  free (table->coefficients);
+  free (table);
+}
 
 /**
- * Resamples the input signal by the desired resampling factor.
- *
- * @param src_size Sample count of the input signal.
- * @param src The input signal.
- * @param resample_handle Handle of the resampler to be used (resample_open(...)).
- * @param resample_factor The resampling factor.
- * @param dst_size_max Will contain the sample count of the resampled signal.
+ * Creates a resampler.
  *
- * @return dst The resampled signal (must be freed later).
+ * @param rate_in Sample rate of the input signal (Hz).
+ * @param rate_out Sample rate of the output signal (Hz).
+ * @param quality RESAMPLER_QUALITY_MEDIUM, RESAMPLER_QUALITY_LOW, or RESAMPLER_QUALITY_HIGH.
+ * @param channels Number of channels (processed in lockstep).
  *
- * @warning dst must be freed.
- *
- * @note Uses libresample.
+ * @return The resampler or NULL (must be freed with resampler_close()).
  */
-static inline float *do_resample (unsigned int src_size, float *src, void *resample_handle, double resample_factor, unsigned int *dst_size) {
-  int dst_size_max = (int) (src_size * resample_factor) + 1000; //Maximal sample count for the resampled signal.
-  unsigned int dst_blocksize = (int) (src_size * resample_factor + 10); //Maximal sample count per resampled block.
+static inline t_resampler *resampler_open (unsigned int rate_in, unsigned int rate_out, unsigned int quality, unsigned int channels) {
+  t_resampler *resampler = malloc (sizeof (t_resampler));
+  if (resampler == NULL) {
+    return NULL;
+  }
+
+  resampler->table = resampler_table_get (rate_in, rate_out, quality);
+  if (resampler->table == NULL) {
+    free (resampler);
+    return NULL;
+  }
 
-  float *dst = (float *) calloc (dst_size_max, sizeof (float));
+  resampler->channels = channels;
+  resampler->history = NULL;
+  if (resampler->table->taps > 0) {
+    resampler->history = calloc (channels * 2 * resampler->table->taps, sizeof (float));
+  }
+  if (resampler->history == NULL && resampler->table->taps > 0) {
+    resampler_table_release (resampler->table);
+    free (resampler);
+    return NULL;
+  }
+  resampler->history_index = 0;
+  resampler->phase = resampler->table->up;
 
+  return resampler;
+}
+
+//Returns true if the resampler converts between these rates with this quality and number of channels.
+static inline bool resampler_matches (t_resampler * resampler, unsigned int rate_in, unsigned int rate_out, unsigned int quality, unsigned int channels) {
+  return resampler->table->rate_in == rate_in && resampler->table->rate_out == rate_out && resampler->table->quality == quality && resampler->channels == channels;
+}
+
+//Clears the history, so the resampler behaves as if freshly opened (does not allocate memory).
+static inline void resampler_reset (t_resampler * resampler) {
+  if (resampler->history != NULL) {
+    memset (resampler->history, 0, sizeof (float) * resampler->channels * 2 * resampler->table->taps);
+  }
+  resampler->history_index = 0;
+  resampler->phase = resampler->table->up;
+}
+
+//Returns the group delay of the resampler (seconds); the filter is linear-phase, so the delay is the same for all frequencies.
+static inline double resampler_delay (t_resampler * resampler) {
+  t_resampler_table *table = resampler->table;
+  if (table->taps == 0) {
+    return 0;
+  }
+  return (table->up * table->taps - 1) / (2. * table->up * table->rate_in);
+}
+
+static inline void resampler_close (t_resampler * resampler) {
+  resampler_table_release (resampler->table);
+  free (resampler->history);
+  free (resampler);
+}
+
+//Dot product of one phase with the history (helper function); taps is a multiple of 4.
+static inline float resampler_dot (const float *coefficients, const float *history, unsigned int taps) {
+#if defined(__SSE__)
+  __m128 sum = _mm_setzero_ps ();
+  for (unsigned int i = 0; i < taps; i += 4) {
+    sum = _mm_add_ps (sum, _mm_mul_ps (_mm_loadu_ps (&coefficients[i]), _mm_loadu_ps (&history[i])));
+  }
+  sum = _mm_add_ps (sum, _mm_movehl_ps (sum, sum));
+  sum = _mm_add_ss (sum, _mm_shuffle_ps (sum, sum, 1));
+  return _mm_cvtss_f32 (sum);
+#elif defined(__ARM_NEON)
+  float32x4_t sum = vdupq_n_f32 (0);
+  for (unsigned int i = 0; i < taps; i += 4) {
+    sum = vmlaq_f32 (sum, vld1q_f32 (&coefficients[i]), vld1q_f32 (&history[i]));
+  }
+  float32x2_t sum_half = vadd_f32 (vget_low_f32 (sum), vget_high_f32 (sum));
+  return vget_lane_f32 (vpadd_f32 (sum_half, sum_half), 0);
+#else
+  float sum[4] = { 0, 0, 0, 0 };
+  for (unsigned int i = 0; i < taps; i += 4) {
+    sum[0] += coefficients[i] * history[i];
+    sum[1] += coefficients[i + 1] * history[i + 1];
+    sum[2] += coefficients[i + 2] * history[i + 2];
+    sum[3] += coefficients[i + 3] * history[i + 3];
+  }
+  return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+#endif
+}
+
+//Adds the next input sample of all channels to the history (stored twice) (helper function).
+static inline void resampler_push (t_resampler * resampler, unsigned int taps, float **src, unsigned int src_idx) {
+  resampler->history_index = resampler->history_index == 0 ? taps - 1 : resampler->history_index - 1;
+  float *history = &resampler->history[resampler->history_index];
+  for (unsigned int channel = 0; channel < resampler->channels; channel++) {
+    history[0] = src[channel][src_idx];
+    history[taps] = src[channel][src_idx];
+    history += 2 * taps;
+  }
+}
+
+//Applies one phase to the history of all channels (helper function).
+static inline void resampler_output (t_resampler * resampler, const float *coefficients, unsigned int taps, float **dst, unsigned int dst_idx) {
+  const float *history = &resampler->history[resampler->history_index];
+  for (unsigned int channel = 0; channel < resampler->channels; channel++) {
+    dst[channel][dst_idx] = resampler_dot (coefficients, history, taps);
+    history += 2 * taps;
+  }
+}
+
+//Identity: copies the signal (helper function).
+static inline unsigned int resampler_process_identity (unsigned int src_size, float **src, t_resampler * resampler, float **dst, unsigned int dst_size_max, unsigned int *src_used) {
+  unsigned int size = src_size < dst_size_max ? src_size : dst_size_max;
+  for (unsigned int channel = 0; channel < resampler->channels; channel++) {
+    memcpy (dst[channel], src[channel], sizeof (float) * size);
+  }
+  *src_used = size;
+  return size;
+}
+
+//Integer decimation (up == 1): phase counts the input samples missing for the next output sample (helper function).
+static inline unsigned int resampler_process_decimate (unsigned int src_size, float **src, t_resampler * resampler, float **dst, unsigned int dst_size_max, unsigned int *src_used) {
+  t_resampler_table *table = resampler->table;
+  unsigned int taps = table->taps;
+
+  unsigned int src_idx = 0;
+  unsigned int dst_idx = 0;
+  while (true) {
+    for (; resampler->phase > 0 && src_idx < src_size; resampler->phase--) {
+      resampler_push (resampler, taps, src, src_idx++);
+    }
+
+    if (resampler->phase > 0 || dst_idx == dst_size_max) {
+      break;
+    }
+
+    resampler_output (resampler, table->coefficients, taps, dst, dst_idx++);
+    resampler->phase = table->down;
+  }
+
+  *src_used = src_idx;
+  return dst_idx;
+}
+
+//Integer interpolation (down == 1): phase is the next phase to be applied; up if the next input sample is required (helper function).
+static inline unsigned int resampler_process_interpolate (unsigned int src_size, float **src, t_resampler * resampler, float **dst, unsigned int dst_size_max, unsigned int *src_used) {
+  t_resampler_table *table = resampler->table;
+  unsigned int taps = table->taps;
+
+  unsigned int src_idx = 0;
   unsigned int dst_idx = 0;
-  int dst_samplecount_current;  //Might be negative if resampling fails.
-  int src_processed;
-  unsigned int src_idx = 0, src_blocksize = 512;
-  do {
-    int src_blocksize_current = MIN (src_size - src_idx, src_blocksize);
-    int dst_blocksize_current = MIN (dst_size_max - dst_idx, dst_blocksize);
+  while (true) {
+    for (; resampler->phase < table->up && dst_idx < dst_size_max; resampler->phase++) {
+      resampler_output (resampler, &table->coefficients[resampler->phase * taps], taps, dst, dst_idx++);
+    }
+
+    if (resampler->phase < table->up || src_idx == src_size) {
+      break;
+    }
+
+    resampler_push (resampler, taps, src, src_idx++);
+    resampler->phase = 0;
+  }
 
-    dst_samplecount_current = resample_process (resample_handle, resample_factor, &src[src_idx], src_blocksize_current, 0, &src_processed, &dst[dst_idx], dst_blocksize_current);
+  *src_used = src_idx;
+  return dst_idx;
+}
 
-    src_idx += src_processed;
+/**
+ * Resamples the input signal (all channels) into a preallocated destination.
+ * Resampling stops if either the input signal is completely processed or the destination is full.
+ *
+ * @param src_size Sample count of the input signal (per channel).
+ * @param src The input signal (one array per channel).
+ * @param resampler The resampler to be used (resampler_open(...)).
+ * @param dst The destination for the resampled signal (one array per channel).
+ * @param dst_size_max Maximal sample count that can be written to dst (per channel).
+ * @param src_used Will contain the sample count of the processed input signal (per channel).
+ *
+ * @return Sample count written to dst (per channel).
+ *
+ * @note Does not allocate memory.
+ */
+static inline unsigned int do_resample_into (unsigned int src_size, float **src, t_resampler * resampler, float **dst, unsigned int dst_size_max, unsigned int *src_used) {
+  t_resampler_table *table = resampler->table;
+  unsigned int taps = table->taps;
 
-    if (dst_samplecount_current >= 0) {
-      dst_idx += dst_samplecount_current;
+  if (table->up == table->down) {
+    return resampler_process_identity (src_size, src, resampler, dst, dst_size_max, src_used);
+  }
+  if (table->up == 1) {
+    return resampler_process_decimate (src_size, src, resampler, dst, dst_size_max, src_used);
+  }
+  if (table->down == 1) {
+    return resampler_process_interpolate (src_size, src, resampler, dst, dst_size_max, src_used);
+  }
+
+  unsigned int src_idx = 0;
+  unsigned int dst_idx = 0;
+  while (true) {
+    //Output all samples that only depend on the current history
+    while (resampler->phase < table->up) {
+      if (dst_idx == dst_size_max) {
+        *src_used = src_idx;
+        return dst_idx;
+      }
+      resampler_output (resampler, &table->coefficients[resampler->phase * taps], taps, dst, dst_idx++);
+      resampler->phase += table->down;
     }
-  } while (!(dst_samplecount_current < 0 || (dst_samplecount_current == 0 && src_idx == src_size)));
 
-  *dst_size = dst_idx;
-  return dst;
+    if (src_idx == src_size) {
+      break;
+    }
+
+    resampler_push (resampler, taps, src, src_idx++);
+    resampler->phase -= table->up;
+  }
+
+  *src_used = src_idx;
+  return dst_idx;
 }
 #endif
@@ -6,6 +6,18 @@
 
 Implementation of ringbuffers.
 
+The capacity of a ringbuffer is rounded up to the next power of two, so indices are computed by masking (instead of modulo).
+Adding and removing chunks is done with at most two memcpy() (i.e., before and after the wrap-around).
+If a ringbuffer is full, the oldest elements are overwritten.
+Allocating a ringbuffer larger than RINGBUFFER_CAPACITY_MAX fails (NULL).
+
+Developer note: *_peek() provides the (up to) two spans of a chunk without copying, *_pop_chunk_to() copies a chunk.
+Both do not allocate memory and thus should be used on the DSP-thread.
+
+Mirrored ringbuffers (*_alloc_mirrored()) map the same memory twice back-to-back (memfd; Linux only), so any chunk is contiguous.
+*_pop_chunk() requires a mirrored ringbuffer and returns a pointer into the ringbuffer (valid until the next add).
+If mapping is not available, a mirrored ringbuffer falls back to plain memory of twice the capacity where all writes are duplicated.
+
 */
 
 #ifndef RINGBUFFER_H_
@@ -13,16 +25,102 @@ Implementation of ringbuffers.
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <m_pd.h>
 
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(SYS_memfd_create) && defined(MAP_ANONYMOUS)
+#define RINGBUFFER_HAVE_MEMFD
+#endif
+
+//Memory backends
+#define RINGBUFFER_PLAIN 0      //Memory of the capacity
+#define RINGBUFFER_MIRRORED 1   //Memory of the capacity mapped twice back-to-back
+#define RINGBUFFER_DUPLICATED 2 //Memory of twice the capacity (fallback for mirrored): all writes are duplicated
+
+#define RINGBUFFER_CAPACITY_MAX (1u << 31)
+
+//Returns the next power of two; 0 if size is larger than RINGBUFFER_CAPACITY_MAX (helper function).
+static unsigned int ringbuffer_capacity (unsigned int size) {
+  if (size > RINGBUFFER_CAPACITY_MAX) {
+    return 0;
+  }
+
+  unsigned int capacity = 1;
+  while (capacity < size) {
+    capacity <<= 1;
+  }
+  return capacity;
+}
+
+//Maps memory (multiple of the page size) twice back-to-back and returns the first mapping; returns NULL if not available (helper function).
+static void *ringbuffer_mirror_map (size_t bytes) {
+#ifdef RINGBUFFER_HAVE_MEMFD
+  int fd = syscall (SYS_memfd_create, "ringbuffer", 0);
+  if (fd < 0) {
+    return NULL;
+  }
+  if (ftruncate (fd, bytes) != 0) {
+    close (fd);
+    return NULL;
+  }
+
+  //Reserve the address space for both mappings
+  char *data = mmap (NULL, 2 * bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (data == MAP_FAILED) {
+    close (fd);
+    return NULL;
+  }
+
+  if (mmap (data, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED || mmap (data + bytes, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+    munmap (data, 2 * bytes);
+    close (fd);
+    return NULL;
+  }
+  close (fd);                   //The mappings keep the memory
+
+  return data;
+#else
+  (void) bytes;
+  return NULL;
+#endif
+}
+
+static void ringbuffer_mirror_unmap (void *data, size_t bytes) {
+#ifdef RINGBUFFER_HAVE_MEMFD
+  munmap (data, 2 * bytes);
+#else
+  (void) data;
+  (void) bytes;
+#endif
+}
+
+//Returns the capacity of a mirrored ringbuffer, i.e., at least one page (helper function).
+static unsigned int ringbuffer_capacity_mirrored (unsigned int size, size_t element_size) {
+  unsigned int capacity_page = 1;
+#ifdef RINGBUFFER_HAVE_MEMFD
+  capacity_page = sysconf (_SC_PAGESIZE) / element_size;
+#else
+  (void) element_size;
+#endif
+  return ringbuffer_capacity (size > capacity_page ? size : capacity_page);
+}
+
 //PureData's t_sample
 typedef struct _t_sample_buffer {
   t_sample *data;
-  unsigned int size;
+  unsigned int size;            //Capacity (power of two)
+  unsigned int mask;            //size - 1
   unsigned int number_elements;
   unsigned int chunk_size;
   unsigned int start;
   unsigned int end;
+  unsigned int memory;          //RINGBUFFER_PLAIN, RINGBUFFER_MIRRORED, or RINGBUFFER_DUPLICATED
 } t_sample_buffer;
 
 static t_sample_buffer *t_sample_buffer_alloc (unsigned int size, unsigned int chunk_size) {
@@ -31,13 +129,52 @@ static t_sample_buffer *t_sample_buffer_alloc (unsigned int size, unsigned int c
     return NULL;
   }
 
-  buffer->data = malloc (sizeof (t_sample) * size);
+  buffer->size = ringbuffer_capacity (size);
+  if (buffer->size == 0) {
+    free (buffer);
+    return NULL;                //Too large
+  }
+  buffer->mask = buffer->size - 1;
+  buffer->memory = RINGBUFFER_PLAIN;
+
+  buffer->data = malloc (sizeof (t_sample) * buffer->size);
+  if (buffer->data == NULL) {
+    free (buffer);
+    return NULL;
+  }
+
+  buffer->number_elements = 0;
+  buffer->start = 0;
+  buffer->end = 0;
+  buffer->chunk_size = chunk_size;
+  return buffer;
+}
+
+//Allocates a ringbuffer where any chunk is contiguous (see RINGBUFFER_MIRRORED and RINGBUFFER_DUPLICATED).
+static t_sample_buffer *t_sample_buffer_alloc_mirrored (unsigned int size, unsigned int chunk_size) {
+  t_sample_buffer *buffer = malloc (sizeof (t_sample_buffer));
+  if (buffer == NULL) {
+    return NULL;
+  }
+
+  buffer->size = ringbuffer_capacity_mirrored (size, sizeof (t_sample));
+  if (buffer->size == 0) {
+    free (buffer);
+    return NULL;                //Too large
+  }
+  buffer->mask = buffer->size - 1;
+  buffer->memory = RINGBUFFER_MIRRORED;
+
+  buffer->data = ringbuffer_mirror_map (sizeof (t_sample) * buffer->size);
+  if (buffer->data == NULL) {
+    buffer->memory = RINGBUFFER_DUPLICATED;
+    buffer->data = malloc (sizeof (t_sample) * buffer->size * 2);
+  }
   if (buffer->data == NULL) {
     free (buffer);
     return NULL;
   }
 
-  buffer->size = size;
   buffer->number_elements = 0;
   buffer->start = 0;
   buffer->end = 0;
@@ -46,21 +183,79 @@ static t_sample_buffer *t_sample_buffer_alloc (unsigned int size, unsigned int c
 }
 
 static void t_sample_buffer_free (t_sample_buffer * buffer) {
-  free (buffer->data);
+  if (buffer->memory == RINGBUFFER_MIRRORED) {
+    ringbuffer_mirror_unmap (buffer->data, sizeof (t_sample) * buffer->size);
+  } else {
+    free (buffer->data);
+  }
 }
 
 static void t_sample_buffer_add (t_sample_buffer * buffer, t_sample element) {
   buffer->data[buffer->end] = element;
-  buffer->end = (buffer->end + 1) % buffer->size;
-  if (buffer->end == buffer->start) {
-    buffer->start = (buffer->start + 1) % buffer->size;
+  if (buffer->memory == RINGBUFFER_DUPLICATED) {
+    buffer->data[buffer->end + buffer->size] = element;
+  }
+
+  buffer->end = (buffer->end + 1) & buffer->mask;
+  if (buffer->number_elements == buffer->size) {
+    buffer->start = buffer->end;
+  } else {
+    buffer->number_elements++;
+  }
+}
+
+//Returns the contiguous writeable region starting at the end of the buffer (might overwrite the oldest elements); must be followed by t_sample_buffer_commit().
+static unsigned int t_sample_buffer_free_region (t_sample_buffer * buffer, t_sample ** region) {
+  *region = &buffer->data[buffer->end];
+  if (buffer->memory == RINGBUFFER_MIRRORED) {
+    return buffer->size;
+  }
+  return buffer->size - buffer->end;
+}
+
+//Marks size elements written to the region returned by t_sample_buffer_free_region() as added.
+static void t_sample_buffer_commit (t_sample_buffer * buffer, unsigned int size) {
+  if (buffer->memory == RINGBUFFER_DUPLICATED) {
+    memcpy (&buffer->data[buffer->end + buffer->size], &buffer->data[buffer->end], sizeof (t_sample) * size);
+  }
+
+  buffer->end = (buffer->end + size) & buffer->mask;
+  buffer->number_elements += size;
+  if (buffer->number_elements >= buffer->size) {
+    buffer->number_elements = buffer->size;
+    buffer->start = buffer->end;
   }
-  buffer->number_elements++;
 }
 
 static void t_sample_buffer_add_chunk (t_sample_buffer * buffer, t_sample * chunk, unsigned int size) {
-  for (int i = 0; i < size; i++) {
-    t_sample_buffer_add (buffer, chunk[i]);
+  if (size > buffer->size) {
+    //Only the last elements remain
+    chunk += size - buffer->size;
+    buffer->number_elements += size - buffer->size;
+    size = buffer->size;
+  }
+
+  if (buffer->memory == RINGBUFFER_MIRRORED) {
+    memcpy (&buffer->data[buffer->end], chunk, sizeof (t_sample) * size);
+  } else {
+    unsigned int size_first = buffer->size - buffer->end;
+    if (size_first > size) {
+      size_first = size;
+    }
+    memcpy (&buffer->data[buffer->end], chunk, sizeof (t_sample) * size_first);
+    memcpy (buffer->data, &chunk[size_first], sizeof (t_sample) * (size - size_first));
+
+    if (buffer->memory == RINGBUFFER_DUPLICATED) {
+      memcpy (&buffer->data[buffer->end + buffer->size], chunk, sizeof (t_sample) * size_first);
+      memcpy (&buffer->data[buffer->size], &chunk[size_first], sizeof (t_sample) * (size - size_first));
+    }
+  }
+
+  buffer->end = (buffer->end + size) & buffer->mask;
+  buffer->number_elements += size;
+  if (buffer->number_elements >= buffer->size) {
+    buffer->number_elements = buffer->size;
+    buffer->start = buffer->end;
   }
 }
 
@@ -68,30 +263,58 @@ static bool t_sample_buffer_has_chunk (t_sample_buffer * buffer) {
   return buffer->number_elements >= buffer->chunk_size;
 }
 
-static void t_sample_buffer_pop_chunk (t_sample_buffer * buffer, t_sample ** chunk, unsigned int size, bool * manual_delete) {
-  if (buffer->start > (buffer->start + size) % buffer->size) {
-    *manual_delete = 1;
-    t_sample *cpx = (t_sample *) malloc (sizeof (t_sample) * size);
-    for (int i = 0; i < size; i++) {
-      cpx[i] = buffer->data[buffer->start];
-      buffer->start = (buffer->start + 1) % buffer->size;
-      *chunk = cpx;
-    }
-  } else {
-    *chunk = &buffer->data[buffer->start];
-    buffer->start = (buffer->start + size) % buffer->size;
+//Provides the first size elements as two spans (the second span is empty if the chunk does not wrap around or the buffer is mirrored); elements are not removed.
+static void t_sample_buffer_peek (t_sample_buffer * buffer, unsigned int size, t_sample ** span_first, unsigned int *size_first, t_sample ** span_second, unsigned int *size_second) {
+  *span_first = &buffer->data[buffer->start];
+  *size_first = buffer->size - buffer->start;
+  if (*size_first > size || buffer->memory != RINGBUFFER_PLAIN) {
+    *size_first = size;
   }
+  *span_second = buffer->data;
+  *size_second = size - *size_first;
+}
+
+//Removes the first size elements.
+static void t_sample_buffer_skip (t_sample_buffer * buffer, unsigned int size) {
+  buffer->start = (buffer->start + size) & buffer->mask;
   buffer->number_elements -= size;
 }
 
+/**
+ * Removes a chunk from the buffer without copying.
+ *
+ * @return Pointer to the contiguous chunk; valid until the next add.
+ *
+ * @warning Requires a mirrored ringbuffer (t_sample_buffer_alloc_mirrored()).
+ */
+static t_sample *t_sample_buffer_pop_chunk (t_sample_buffer * buffer, unsigned int size) {
+  t_sample *chunk = &buffer->data[buffer->start];
+  t_sample_buffer_skip (buffer, size);
+  return chunk;
+}
+
+//Copies a chunk to the destination and removes it from the buffer (no memory is allocated).
+static void t_sample_buffer_pop_chunk_to (t_sample_buffer * buffer, t_sample * dst, unsigned int size) {
+  t_sample *span_first, *span_second;
+  unsigned int size_first, size_second;
+  t_sample_buffer_peek (buffer, size, &span_first, &size_first, &span_second, &size_second);
+
+  memcpy (dst, span_first, sizeof (t_sample) * size_first);
+  memcpy (&dst[size_first], span_second, sizeof (t_sample) * size_second);
+
+  t_sample_buffer_skip (buffer, size);
+}
+
 //Float
 typedef struct _float_buffer {
   float *data;
-  unsigned int size;
+  unsigned int size;            //Capacity (power of two)
+  unsigned int mask;            //size - 1
   unsigned int number_elements;
   unsigned int chunk_size;
   unsigned int start;
   unsigned int end;
+  unsigned int memory;          //RINGBUFFER_PLAIN, RINGBUFFER_MIRRORED, or RINGBUFFER_DUPLICATED
 } float_buffer;
 
 static float_buffer *float_buffer_alloc (unsigned int size, unsigned int chunk_size) {
@@ -100,13 +323,52 @@ static float_buffer *float_buffer_alloc (unsigned int size, unsigned int chunk_s
     return NULL;
   }
 
-  buffer->data = malloc (sizeof (float) * size);
+  buffer->size = ringbuffer_capacity (size);
+  if (buffer->size == 0) {
+    free (buffer);
+    return NULL;                //Too large
+  }
+  buffer->mask = buffer->size - 1;
+  buffer->memory = RINGBUFFER_PLAIN;
+
+  buffer->data = malloc (sizeof (float) * buffer->size);
+  if (buffer->data == NULL) {
+    free (buffer);
+    return NULL;
+  }
+
+  buffer->number_elements = 0;
+  buffer->start = 0;
+  buffer->end = 0;
+  buffer->chunk_size = chunk_size;
+  return buffer;
+}
+
+//Allocates a ringbuffer where any chunk is contiguous (see RINGBUFFER_MIRRORED and RINGBUFFER_DUPLICATED).
+static float_buffer *float_buffer_alloc_mirrored (unsigned int size, unsigned int chunk_size) {
+  float_buffer *buffer = malloc (sizeof (float_buffer));
+  if (buffer == NULL) {
+    return NULL;
+  }
+
+  buffer->size = ringbuffer_capacity_mirrored (size, sizeof (float));
+  if (buffer->size == 0) {
+    free (buffer);
+    return NULL;                //Too large
+  }
+  buffer->mask = buffer->size - 1;
+  buffer->memory = RINGBUFFER_MIRRORED;
+
+  buffer->data = ringbuffer_mirror_map (sizeof (float) * buffer->size);
+  if (buffer->data == NULL) {
+    buffer->memory = RINGBUFFER_DUPLICATED;
+    buffer->data = malloc (sizeof (float) * buffer->size * 2);
+  }
   if (buffer->data == NULL) {
     free (buffer);
     return NULL;
   }
 
-  buffer->size = size;
   buffer->number_elements = 0;
   buffer->start = 0;
   buffer->end = 0;
@@ -115,21 +377,79 @@ static float_buffer *float_buffer_alloc (unsigned int size, unsigned int chunk_s
 }
 
 static void float_buffer_free (float_buffer * buffer) {
-  free (buffer->data);
+  if (buffer->memory == RINGBUFFER_MIRRORED) {
+    ringbuffer_mirror_unmap (buffer->data, sizeof (float) * buffer->size);
+  } else {
+    free (buffer->data);
+  }
 }
 
 static void float_buffer_add (float_buffer * buffer, float element) {
   buffer->data[buffer->end] = element;
-  buffer->end = (buffer->end + 1) % buffer->size;
-  if (buffer->end == buffer->start) {
-    buffer->start = (buffer->start + 1) % buffer->size;
+  if (buffer->memory == RINGBUFFER_DUPLICATED) {
+    buffer->data[buffer->end + buffer->size] = element;
+  }
+
+  buffer->end = (buffer->end + 1) & buffer->mask;
+  if (buffer->number_elements == buffer->size) {
+    buffer->start = buffer->end;
+  } else {
+    buffer->number_elements++;
+  }
+}
+
+//Returns the contiguous writeable region starting at the end of the buffer (might overwrite the oldest elements); must be followed by float_buffer_commit().
+static unsigned int float_buffer_free_region (float_buffer * buffer, float ** region) {
+  *region = &buffer->data[buffer->end];
+  if (buffer->memory == RINGBUFFER_MIRRORED) {
+    return buffer->size;
   }
-  buffer->number_elements++;
+  return buffer->size - buffer->end;
 }
 
-static void float_buffer_add_chunk (float_buffer * buffer, float *chunk, unsigned int size) {
-  for (int i = 0; i < size; i++) {
-    float_buffer_add (buffer, chunk[i]);
+//Marks size elements written to the region returned by float_buffer_free_region() as added.
+static void float_buffer_commit (float_buffer * buffer, unsigned int size) {
+  if (buffer->memory == RINGBUFFER_DUPLICATED) {
+    memcpy (&buffer->data[buffer->end + buffer->size], &buffer->data[buffer->end], sizeof (float) * size);
+  }
+
+  buffer->end = (buffer->end + size) & buffer->mask;
+  buffer->number_elements += size;
+  if (buffer->number_elements >= buffer->size) {
+    buffer->number_elements = buffer->size;
+    buffer->start = buffer->end;
+  }
+}
+
+static void float_buffer_add_chunk (float_buffer * buffer, float * chunk, unsigned int size) {
+  if (size > buffer->size) {
+    //Only the last elements remain
+    chunk += size - buffer->size;
+    buffer->number_elements += size - buffer->size;
+    size = buffer->size;
+  }
+
+  if (buffer->memory == RINGBUFFER_MIRRORED) {
+    memcpy (&buffer->data[buffer->end], chunk, sizeof (float) * size);
+  } else {
+    unsigned int size_first = buffer->size - buffer->end;
+    if (size_first > size) {
+      size_first = size;
+    }
+    memcpy (&buffer->data[buffer->end], chunk, sizeof (float) * size_first);
+    memcpy (buffer->data, &chunk[size_first], sizeof (float) * (size - size_first));
+
+    if (buffer->memory == RINGBUFFER_DUPLICATED) {
+      memcpy (&buffer->data[buffer->end + buffer->size], chunk, sizeof (float) * size_first);
+      memcpy (&buffer->data[buffer->size], &chunk[size_first], sizeof (float) * (size - size_first));
+    }
+  }
+
+  buffer->end = (buffer->end + size) & buffer->mask;
+  buffer->number_elements += size;
+  if (buffer->number_elements >= buffer->size) {
+    buffer->number_elements = buffer->size;
+    buffer->start = buffer->end;
   }
 }
 
@@ -141,39 +461,46 @@ static bool float_buffer_has_chunk_n (float_buffer * buffer, unsigned int n) {
   return buffer->number_elements >= buffer->chunk_size * n;
 }
 
-static void float_buffer_read_chunk_n (float_buffer * buffer, float **chunk, unsigned int size, unsigned int n, bool * manual_delete) {
-
-  unsigned int buffer_index = (buffer->start + size * n) % buffer->size;
-
-  if (buffer->start + size * n > buffer_index) {
-    *manual_delete = true;
-    float *cpx = (float *) malloc (sizeof (float) * size);
-    for (int i = 0; i < size; i++) {
-      cpx[i] = buffer->data[buffer_index];
-      buffer_index = (buffer_index + 1) % buffer->size;
-      *chunk = cpx;
-    }
-  } else {
-    *manual_delete = false;
-    *chunk = &buffer->data[buffer_index];
+//Provides the first size elements as two spans (the second span is empty if the chunk does not wrap around or the buffer is mirrored); elements are not removed.
+static void float_buffer_peek (float_buffer * buffer, unsigned int size, float ** span_first, unsigned int *size_first, float ** span_second, unsigned int *size_second) {
+  *span_first = &buffer->data[buffer->start];
+  *size_first = buffer->size - buffer->start;
+  if (*size_first > size || buffer->memory != RINGBUFFER_PLAIN) {
+    *size_first = size;
   }
+  *span_second = buffer->data;
+  *size_second = size - *size_first;
 }
 
-static void float_buffer_pop_chunk (float_buffer * buffer, float **chunk, unsigned int size, bool * manual_delete) {
-  if (buffer->start > (buffer->start + size) % buffer->size) {
-    *manual_delete = true;
-    float *cpx = (float *) malloc (sizeof (float) * size);
-    for (int i = 0; i < size; i++) {
-      cpx[i] = buffer->data[buffer->start];
-      buffer->start = (buffer->start + 1) % buffer->size;
-      *chunk = cpx;
-    }
-  } else {
-    *manual_delete = false;
-    *chunk = &buffer->data[buffer->start];
-    buffer->start = (buffer->start + size) % buffer->size;
-  }
+//Removes the first size elements.
+static void float_buffer_skip (float_buffer * buffer, unsigned int size) {
+  buffer->start = (buffer->start + size) & buffer->mask;
   buffer->number_elements -= size;
 }
 
+/**
+ * Removes a chunk from the buffer without copying.
+ *
+ * @return Pointer to the contiguous chunk; valid until the next add.
+ *
+ * @warning Requires a mirrored ringbuffer (float_buffer_alloc_mirrored()).
+ */
+static float *float_buffer_pop_chunk (float_buffer * buffer, unsigned int size) {
+  float *chunk = &buffer->data[buffer->start];
+  float_buffer_skip (buffer, size);
+  return chunk;
+}
+
+//Copies a chunk to the destination and removes it from the buffer (no memory is allocated).
+static void float_buffer_pop_chunk_to (float_buffer * buffer, float * dst, unsigned int size) {
+  float *span_first, *span_second;
+  unsigned int size_first, size_second;
+  float_buffer_peek (buffer, size, &span_first, &size_first, &span_second, &size_second);
+
+  memcpy (dst, span_first, sizeof (float) * size_first);
+  memcpy (&dst[size_first], span_second, sizeof (float) * size_second);
+
+  float_buffer_skip (buffer, size);
+}
+
 #endif /* RINGBUFFER_H_ */
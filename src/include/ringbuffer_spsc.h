@@ -0,0 +1,139 @@
+/**
+@file ringbuffer_spsc.h
+@author Frank Haase, Dennis Guse
+@date 2026-10-16
+@license GPLv3 or later
+
+Implementation of a wait-free single-producer/single-consumer ringbuffer (float).
+
+Moves audio or control frames between exactly two threads (e.g., a worker thread and PureData's DSP-thread) without locks.
+One thread only adds (producer), the other thread only removes (consumer).
+
+In contrast to float_buffer (ringbuffer.h), a full ringbuffer does NOT overwrite the oldest elements: adding fails instead.
+
+Developer note: head (written by the producer) and tail (written by the consumer) are free-running counters on separate cache lines.
+Each thread caches the counter of the other thread, so the shared cache line is only read if the cached value is not sufficient.
+
+Developer note: requires C11 atomics (stdatomic.h).
+Developer note: the struct is allocated with aligned_alloc(); its size is rounded up to a multiple of the cache line (required by C11).
+
+*/
+
+#ifndef RINGBUFFER_SPSC_H_
+#define RINGBUFFER_SPSC_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RINGBUFFER_SPSC_CACHE_LINE 64
+#define RINGBUFFER_SPSC_CAPACITY_MAX (1u << 31)
+
+typedef struct _float_buffer_spsc {
+  //Producer
+  atomic_uint head;
+  unsigned int tail_cached;
+  char padding_producer[RINGBUFFER_SPSC_CACHE_LINE - sizeof (atomic_uint) - sizeof (unsigned int)];
+
+  //Consumer
+  atomic_uint tail;
+  unsigned int head_cached;
+  char padding_consumer[RINGBUFFER_SPSC_CACHE_LINE - sizeof (atomic_uint) - sizeof (unsigned int)];
+
+  //Read-only after allocation
+  float *data;
+  unsigned int size;            //Capacity (power of two)
+  unsigned int mask;            //size - 1
+} float_buffer_spsc;
+
+//Allocates a ringbuffer for at least size elements; returns NULL if size is larger than RINGBUFFER_SPSC_CAPACITY_MAX.
+static float_buffer_spsc *float_buffer_spsc_alloc (unsigned int size) {
+  if (size > RINGBUFFER_SPSC_CAPACITY_MAX) {
+    return NULL;
+  }
+
+  size_t bytes = (sizeof (float_buffer_spsc) + RINGBUFFER_SPSC_CACHE_LINE - 1) / RINGBUFFER_SPSC_CACHE_LINE * RINGBUFFER_SPSC_CACHE_LINE;
+  float_buffer_spsc *buffer = aligned_alloc (RINGBUFFER_SPSC_CACHE_LINE, bytes);
+  if (buffer == NULL) {
+    return NULL;
+  }
+
+  buffer->size = 1;
+  while (buffer->size < size) {
+    buffer->size <<= 1;
+  }
+  buffer->mask = buffer->size - 1;
+
+  buffer->data = malloc (sizeof (float) * buffer->size);
+  if (buffer->data == NULL) {
+    free (buffer);
+    return NULL;
+  }
+
+  atomic_init (&buffer->head, 0);
+  atomic_init (&buffer->tail, 0);
+  buffer->tail_cached = 0;
+  buffer->head_cached = 0;
+  return buffer;
+}
+
+//Frees the ringbuffer including the struct; neither thread may use it afterwards.
+static void float_buffer_spsc_free (float_buffer_spsc * buffer) {
+  free (buffer->data);
+  free (buffer);
+}
+
+//Producer: returns the number of elements that can be added.
+static unsigned int float_buffer_spsc_free_elements (float_buffer_spsc * buffer) {
+  unsigned int head = atomic_load_explicit (&buffer->head, memory_order_relaxed);
+  buffer->tail_cached = atomic_load_explicit (&buffer->tail, memory_order_acquire);
+  return buffer->size - (head - buffer->tail_cached);
+}
+
+//Producer: adds the complete chunk or nothing; returns false if not enough space is available.
+static bool float_buffer_spsc_add_chunk (float_buffer_spsc * buffer, const float *chunk, unsigned int size) {
+  unsigned int head = atomic_load_explicit (&buffer->head, memory_order_relaxed);
+  if (buffer->size - (head - buffer->tail_cached) < size && float_buffer_spsc_free_elements (buffer) < size) {
+    return false;
+  }
+
+  unsigned int index = head & buffer->mask;
+  unsigned int size_first = buffer->size - index;
+  if (size_first > size) {
+    size_first = size;
+  }
+  memcpy (&buffer->data[index], chunk, sizeof (float) * size_first);
+  memcpy (buffer->data, &chunk[size_first], sizeof (float) * (size - size_first));
+
+  atomic_store_explicit (&buffer->head, head + size, memory_order_release);
+  return true;
+}
+
+//Consumer: returns the number of elements that can be removed.
+static unsigned int float_buffer_spsc_number_elements (float_buffer_spsc * buffer) {
+  unsigned int tail = atomic_load_explicit (&buffer->tail, memory_order_relaxed);
+  buffer->head_cached = atomic_load_explicit (&buffer->head, memory_order_acquire);
+  return buffer->head_cached - tail;
+}
+
+//Consumer: copies a chunk to the destination and removes it; returns false (and copies nothing) if less than size elements are available.
+static bool float_buffer_spsc_pop_chunk_to (float_buffer_spsc * buffer, float *dst, unsigned int size) {
+  unsigned int tail = atomic_load_explicit (&buffer->tail, memory_order_relaxed);
+  if (buffer->head_cached - tail < size && float_buffer_spsc_number_elements (buffer) < size) {
+    return false;
+  }
+
+  unsigned int index = tail & buffer->mask;
+  unsigned int size_first = buffer->size - index;
+  if (size_first > size) {
+    size_first = size;
+  }
+  memcpy (dst, &buffer->data[index], sizeof (float) * size_first);
+  memcpy (&dst[size_first], buffer->data, sizeof (float) * (size - size_first));
+
+  atomic_store_explicit (&buffer->tail, tail + size, memory_order_release);
+  return true;
+}
+
+#endif /* RINGBUFFER_SPSC_H_ */
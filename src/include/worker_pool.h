@@ -0,0 +1,241 @@
+/**
+@file worker_pool.h
+@author Frank Haase, Dennis Guse
+@date 2026-10-16
+@license GPLv3 or later
+
+Implementation of a pool of worker threads that executes jobs submitted by PureData's DSP-thread.
+
+A job is submitted by the DSP-thread (worker_job_submit()) and later collected by the DSP-thread (worker_job_collect()).
+If the job was not yet started by a worker, worker_job_collect() executes it on the DSP-thread (i.e., the job is never lost).
+
+Developer note: the DSP-thread never blocks: if the queue is locked or full, the job is executed by worker_job_collect(); if a worker is still running the job, worker_job_collect() returns false and the DSP-thread tries again in the next DSP tick.
+Developer note: only PureData's main thread blocks on the condition of the job (worker_job_cancel(); no busy-waiting).
+Developer note: the pool is shared by all instances of one external (static variables) and reference-counted; it must be acquired and released by PureData's main thread.
+Developer note: a worker may dequeue a job that was already executed by the DSP-thread; such (stale) entries are skipped.
+Developer note: a job counts the entries dequeued by workers that still access it (dequeued); worker_job_cancel() waits until none is left, so the job may be freed afterwards.
+
+@see generic_codec.h
+*/
+
+#ifndef WORKER_POOL_H_
+#define WORKER_POOL_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#define WORKER_POOL_THREADS_MAX 16
+#define WORKER_POOL_QUEUE_SIZE 256
+
+#define WORKER_JOB_IDLE 0
+#define WORKER_JOB_QUEUED 1
+#define WORKER_JOB_RUNNING 2
+#define WORKER_JOB_DONE 3
+
+typedef void (*t_worker_job_function) (void *data);
+
+typedef struct _worker_job {
+  atomic_int state;             //WORKER_JOB_*
+  t_worker_job_function function;
+  void *data;
+
+  pthread_mutex_t mutex;        //Protects the transition to WORKER_JOB_DONE
+  pthread_cond_t done;          //Signaled if the job is done
+
+  unsigned int dequeued;        //Entries removed from the queue by workers that still access the job (protected by worker_pool.mutex)
+} t_worker_job;
+
+static struct {
+  pthread_mutex_t mutex;
+  pthread_cond_t condition;
+  pthread_cond_t released;      //Signaled if the dequeued entries of a job were released
+  pthread_t threads[WORKER_POOL_THREADS_MAX];
+  unsigned int threads_size;
+
+  t_worker_job *queue[WORKER_POOL_QUEUE_SIZE];
+  unsigned int queue_head;      //Next job to be removed
+  unsigned int queue_size;
+
+  bool exit;
+  unsigned int references;
+} worker_pool = {.mutex = PTHREAD_MUTEX_INITIALIZER,.condition = PTHREAD_COND_INITIALIZER,.released = PTHREAD_COND_INITIALIZER };
+
+static inline void worker_job_init (t_worker_job * job, t_worker_job_function function, void *data) {
+  atomic_init (&job->state, WORKER_JOB_IDLE);
+  job->function = function;
+  job->data = data;
+  pthread_mutex_init (&job->mutex, NULL);
+  pthread_cond_init (&job->done, NULL);
+  job->dequeued = 0;
+}
+
+//Frees the resources of the job (must be idle, e.g., after worker_job_cancel()).
+static inline void worker_job_destroy (t_worker_job * job) {
+  pthread_mutex_destroy (&job->mutex);
+  pthread_cond_destroy (&job->done);
+}
+
+//Executes the job if it was not yet started by another thread (helper function).
+static inline bool worker_job_try_run (t_worker_job * job) {
+  int expected = WORKER_JOB_QUEUED;
+  if (!atomic_compare_exchange_strong_explicit (&job->state, &expected, WORKER_JOB_RUNNING, memory_order_acquire, memory_order_relaxed)) {
+    return false;
+  }
+
+  job->function (job->data);
+
+  pthread_mutex_lock (&job->mutex);
+  atomic_store_explicit (&job->state, WORKER_JOB_DONE, memory_order_release);
+  pthread_cond_signal (&job->done);
+  pthread_mutex_unlock (&job->mutex);
+  return true;
+}
+
+static void *worker_pool_thread (void *unused) {
+  (void) unused;
+
+  while (true) {
+    pthread_mutex_lock (&worker_pool.mutex);
+    while (worker_pool.queue_size == 0 && !worker_pool.exit) {
+      pthread_cond_wait (&worker_pool.condition, &worker_pool.mutex);
+    }
+    if (worker_pool.exit) {
+      pthread_mutex_unlock (&worker_pool.mutex);
+      return NULL;
+    }
+
+    t_worker_job *job = worker_pool.queue[worker_pool.queue_head];
+    worker_pool.queue_head = (worker_pool.queue_head + 1) % WORKER_POOL_QUEUE_SIZE;
+    worker_pool.queue_size--;
+    job->dequeued++;
+    pthread_mutex_unlock (&worker_pool.mutex);
+
+    worker_job_try_run (job);
+
+    pthread_mutex_lock (&worker_pool.mutex);
+    job->dequeued--;
+    if (job->dequeued == 0) {
+      pthread_cond_broadcast (&worker_pool.released);
+    }
+    pthread_mutex_unlock (&worker_pool.mutex);
+  }
+}
+
+//Starts the worker threads on first use (one per CPU core except the core of the DSP-thread); returns false if no thread could be started.
+static bool worker_pool_acquire () {
+  if (worker_pool.references > 0) {
+    worker_pool.references++;
+    return true;
+  }
+
+  long cores = sysconf (_SC_NPROCESSORS_ONLN);
+  unsigned int threads_size = cores > 2 ? cores - 1 : 1;
+  if (threads_size > WORKER_POOL_THREADS_MAX) {
+    threads_size = WORKER_POOL_THREADS_MAX;
+  }
+
+  worker_pool.exit = false;
+  worker_pool.queue_head = 0;
+  worker_pool.queue_size = 0;
+  worker_pool.threads_size = 0;
+  for (unsigned int i = 0; i < threads_size; i++) {
+    if (pthread_create (&worker_pool.threads[worker_pool.threads_size], NULL, worker_pool_thread, NULL) == 0) {
+      worker_pool.threads_size++;
+    }
+  }
+
+  if (worker_pool.threads_size == 0) {
+    return false;
+  }
+  worker_pool.references = 1;
+  return true;
+}
+
+//Stops the worker threads if the pool is not used anymore.
+static void worker_pool_release () {
+  if (worker_pool.references == 0 || --worker_pool.references > 0) {
+    return;
+  }
+
+  pthread_mutex_lock (&worker_pool.mutex);
+  worker_pool.exit = true;
+  pthread_cond_broadcast (&worker_pool.condition);
+  pthread_mutex_unlock (&worker_pool.mutex);
+
+  for (unsigned int i = 0; i < worker_pool.threads_size; i++) {
+    pthread_join (worker_pool.threads[i], NULL);
+  }
+  worker_pool.threads_size = 0;
+}
+
+//DSP-thread: submits the job (must be idle); does not block.
+static inline void worker_job_submit (t_worker_job * job) {
+  atomic_store_explicit (&job->state, WORKER_JOB_QUEUED, memory_order_release);
+
+  if (pthread_mutex_trylock (&worker_pool.mutex) != 0) {
+    return;                     //Executed by worker_job_collect()
+  }
+  if (worker_pool.queue_size < WORKER_POOL_QUEUE_SIZE) {
+    worker_pool.queue[(worker_pool.queue_head + worker_pool.queue_size) % WORKER_POOL_QUEUE_SIZE] = job;
+    worker_pool.queue_size++;
+    pthread_cond_signal (&worker_pool.condition);
+  }
+  pthread_mutex_unlock (&worker_pool.mutex);
+}
+
+//DSP-thread: collects the job without blocking (executes it if not yet started); returns false if a worker is still running it, otherwise the job is idle afterwards.
+static inline bool worker_job_collect (t_worker_job * job) {
+  int state = atomic_load_explicit (&job->state, memory_order_acquire);
+  if (state == WORKER_JOB_IDLE) {
+    return true;
+  }
+
+  if (state == WORKER_JOB_QUEUED) {
+    worker_job_try_run (job);
+  }
+  if (atomic_load_explicit (&job->state, memory_order_acquire) != WORKER_JOB_DONE) {
+    return false;
+  }
+  atomic_store_explicit (&job->state, WORKER_JOB_IDLE, memory_order_relaxed);
+  return true;
+}
+
+//Main thread: waits until the job is done (executes it if not yet started); afterwards the job is idle (helper function).
+static inline void worker_job_wait (t_worker_job * job) {
+  if (atomic_load_explicit (&job->state, memory_order_acquire) == WORKER_JOB_IDLE) {
+    return;
+  }
+
+  if (!worker_job_try_run (job)) {
+    pthread_mutex_lock (&job->mutex);
+    while (atomic_load_explicit (&job->state, memory_order_acquire) != WORKER_JOB_DONE) {
+      pthread_cond_wait (&job->done, &job->mutex);
+    }
+    pthread_mutex_unlock (&job->mutex);
+  }
+  atomic_store_explicit (&job->state, WORKER_JOB_IDLE, memory_order_relaxed);
+}
+
+//Main thread (DSP of the job is stopped): removes the job from the queue and waits until it is idle and not accessed by a worker anymore.
+static void worker_job_cancel (t_worker_job * job) {
+  pthread_mutex_lock (&worker_pool.mutex);
+  unsigned int queue_size = 0;
+  for (unsigned int i = 0; i < worker_pool.queue_size; i++) {
+    t_worker_job *queued = worker_pool.queue[(worker_pool.queue_head + i) % WORKER_POOL_QUEUE_SIZE];
+    if (queued != job) {
+      worker_pool.queue[(worker_pool.queue_head + queue_size) % WORKER_POOL_QUEUE_SIZE] = queued;
+      queue_size++;
+    }
+  }
+  worker_pool.queue_size = queue_size;
+  while (job->dequeued > 0) {
+    pthread_cond_wait (&worker_pool.released, &worker_pool.mutex);
+  }
+  pthread_mutex_unlock (&worker_pool.mutex);
+
+  worker_job_wait (job);
+}
+
+#endif /* WORKER_POOL_H_ */
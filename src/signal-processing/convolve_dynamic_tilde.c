@@ -133,14 +133,18 @@ void convolve_dynamic_mul (t_convolve_dynamic_tilde * x, unsigned int impulse_re
 }
 
 void convolve_dynamic_add_to_outbuffer (t_convolve_dynamic_tilde * x) {
-  bool free_required = false;
-  float *signal_block;
-  float_buffer_pop_chunk (x->input_buffer, &signal_block, x->input_buffer->chunk_size, &free_required);
+  float *span_first, *span_second;
+  unsigned int size_first, size_second;
+  float_buffer_peek (x->input_buffer, x->input_buffer->chunk_size, &span_first, &size_first, &span_second, &size_second);
 
   //FFT - prepare incoming signal (to be convolved)
-  for (int i = 0; i < x->input_buffer->chunk_size; i++) {
-    x->fftw_in[i] = signal_block[i];
+  for (int i = 0; i < size_first; i++) {
+    x->fftw_in[i] = span_first[i];
+  }
+  for (int i = 0; i < size_second; i++) {
+    x->fftw_in[size_first + i] = span_second[i];
   }
+  float_buffer_skip (x->input_buffer, x->input_buffer->chunk_size);
   for (int i = x->input_buffer->chunk_size; i < x->irtf_length; i++) {
     x->fftw_in[i] = 0;
   }
@@ -198,24 +202,20 @@ void convolve_dynamic_add_to_outbuffer (t_convolve_dynamic_tilde * x) {
   for (int i = 0; i < x->input_buffer->chunk_size; i++) {
     x->overlap_add[i] = x->fftw_out[x->input_buffer->chunk_size + i];
   }
-
-  if (free_required) {
-    free (signal_block);
-  }
 }
 
 void convolve_dynamic_add_to_output (t_convolve_dynamic_tilde * x, t_sample * out) {
-  bool free_required = false;
-  float *signal_block;
-  float_buffer_pop_chunk (x->output_buffer, &signal_block, x->output_buffer->chunk_size, &free_required);
+  float *span_first, *span_second;
+  unsigned int size_first, size_second;
+  float_buffer_peek (x->output_buffer, x->output_buffer->chunk_size, &span_first, &size_first, &span_second, &size_second);
 
-  for (int i = 0; i < x->output_buffer->chunk_size; i++) {
-    out[i] = signal_block[i];
+  for (int i = 0; i < size_first; i++) {
+    out[i] = span_first[i];
   }
-
-  if (free_required) {
-    free (signal_block);
+  for (int i = 0; i < size_second; i++) {
+    out[size_first + i] = span_second[i];
   }
+  float_buffer_skip (x->output_buffer, x->output_buffer->chunk_size);
 }
 
 void convolve_dynamic_tilde_dsp (t_convolve_dynamic_tilde * x, t_signal ** sp) {
@@ -7,24 +7,29 @@
 denoise_speex~ applies the _noise suppression_ algorithm of [Speex](http://www.speex.org/).
 
 Parameters:
-  denoise_speex~ FRAME_SIZE SAMPLE_RATE MAX_NOISE_ATTENUATION
+  denoise_speex~ FRAME_SIZE SAMPLE_RATE MAX_NOISE_ATTENUATION RESAMPLER_QUALITY CHANNELS
   FRAME_SIZE: 80, 160, 240, 320, 640 [samples]
   SAMPLE_RATE: 8000, 16000, 32000 [Hz]
   MAX_NOISE_ATTENUATION: <-100,-1> [dB] (default: -15)
+  RESAMPLER_QUALITY: 0 (medium) [default], 1 (low latency), 2 (high)
+  CHANNELS: number of independent signals (default: 1)
 
 Inlets:
-  1x Audio inlet
+  CHANNELS x Audio inlet
+  also latency: posts the latency (constant; prefill and resampler)
+  also worker 0/1: processes the frames on worker threads (adds one frame of latency; applied on the next DSP start)
+  also phase N: shifts the frame boundaries by N samples (internal sample rate; -1: automatic [default]; applied on the next DSP start)
   
 Outlets:
-  1x Audio outlet
+  CHANNELS x Audio outlet
 
 @see vad_speex_tilde.c
 
 */
 
 #include <m_pd.h>
-#include <limits.h>
 #include "generic_codec.h"
+#include "convert.h"
 
 #include <speex/speex.h>
 #include <speex/speex_preprocess.h>
@@ -40,74 +45,67 @@ typedef struct _denoise_speex_tilde {
 
   t_generic_codec codec;
 
-  void *speex_preprocess_state;
+  void **speex_preprocess_state;       //One per channel
 
 } t_denoise_speex_tilde;
 
-void denoise_speex_add_to_outbuffer (t_denoise_speex_tilde * x);
+void denoise_speex_process_frames (t_denoise_speex_tilde * x, unsigned int channel, unsigned int n, float *frames) {
+  unsigned int frame_size = x->codec.frame_size;
 
-t_int *denoise_speex_tilde_perform (t_int * w) {
-  t_denoise_speex_tilde *x = (t_denoise_speex_tilde *) (w[1]);
-  t_sample *in = (t_sample *) (w[2]);
-  t_sample *out = (t_sample *) (w[3]);
-  int n = (int) (w[4]);
+  for (unsigned int f = 0; f < n; f++) {
+    float *frame = &frames[f * frame_size];
 
-  generic_codec_resample_to_internal (&x->codec, n, in);
+    short raw[frame_size];
+    convert_float_to_short (frame, raw, frame_size);
 
-  if (float_buffer_has_chunk (x->codec.ringbuffer_input)) {
-    denoise_speex_add_to_outbuffer (x);
-  }
+    speex_preprocess_run (x->speex_preprocess_state[channel], raw);
 
-  if (float_buffer_has_chunk (x->codec.ringbuffer_output)) {
-    generic_codec_to_outbuffer (&x->codec, out);
+    convert_short_to_float (raw, frame, frame_size);
   }
-
-  return (w + 5);
 }
 
-void denoise_speex_add_to_outbuffer (t_denoise_speex_tilde * x) {
-  bool free_required = false;
-  float *frame;
-  float_buffer_pop_chunk (x->codec.ringbuffer_input, &frame, x->codec.ringbuffer_input->chunk_size, &free_required);
-
-  short raw[x->codec.ringbuffer_input->chunk_size];
-
-  for (int i = 0; i < x->codec.ringbuffer_input->chunk_size; i++) {
-    raw[i] = SHRT_MAX * frame[i];
-  }
-
-  speex_preprocess_run (x->speex_preprocess_state, raw);
-
-  for (int i = 0; i < x->codec.frame_size; i++) {
-    frame[i] = (float) raw[i] / SHRT_MAX;
-  }
+void denoise_speex_latency (t_denoise_speex_tilde * x) {
+  generic_codec_post_latency (&x->codec, "denoise_speex~");
+}
 
-  generic_codec_resample_to_external (&x->codec, x->codec.ringbuffer_input->chunk_size, frame);
+void denoise_speex_worker (t_denoise_speex_tilde * x, t_floatarg worker) {
+  generic_codec_set_worker (&x->codec, "denoise_speex~", worker != 0);
+}
 
-  if (free_required) {
-    free (frame);
-  }
+void denoise_speex_phase (t_denoise_speex_tilde * x, t_floatarg phase) {
+  generic_codec_set_phase (&x->codec, "denoise_speex~", phase);
 }
 
 void denoise_speex_tilde_dsp (t_denoise_speex_tilde * x, t_signal ** sp) {
-  if (x->speex_preprocess_state != NULL) {
-    speex_preprocess_state_destroy (x->speex_preprocess_state);
-  }
-
-  x->speex_preprocess_state = speex_preprocess_state_init (x->codec.frame_size, x->codec.sample_rate_internal);
+  generic_codec_dsp_stop (&x->codec);
 
   int denoise_enabled = 1;
-  speex_preprocess_ctl (x->speex_preprocess_state, SPEEX_PREPROCESS_SET_DENOISE, &denoise_enabled);
-  speex_preprocess_ctl (x->speex_preprocess_state, SPEEX_PREPROCESS_SET_NOISE_SUPPRESS, &x->max_noise_attenuation);
+  for (unsigned int channel = 0; channel < x->codec.channels; channel++) {
+    if (x->speex_preprocess_state[channel] != NULL) {
+      speex_preprocess_state_destroy (x->speex_preprocess_state[channel]);
+    }
+
+    x->speex_preprocess_state[channel] = speex_preprocess_state_init (x->codec.frame_size, x->codec.sample_rate_internal);
+
+    speex_preprocess_ctl (x->speex_preprocess_state[channel], SPEEX_PREPROCESS_SET_DENOISE, &denoise_enabled);
+    speex_preprocess_ctl (x->speex_preprocess_state[channel], SPEEX_PREPROCESS_SET_NOISE_SUPPRESS, &x->max_noise_attenuation);
+  }
 
-  generic_codec_dsp_add (&x->codec, sp[0]->s_n, x, denoise_speex_tilde_perform, sp);
+  generic_codec_dsp_add (&x->codec, sp[0]->s_n, &x->codec, generic_codec_perform, sp);
 }
 
 void denoise_speex_tilde_free (t_denoise_speex_tilde * x) {
   generic_codec_free (&x->codec);
+
+  for (unsigned int channel = 0; channel < x->codec.channels; channel++) {
+    if (x->speex_preprocess_state[channel] != NULL) {
+      speex_preprocess_state_destroy (x->speex_preprocess_state[channel]);
+    }
+  }
+  free (x->speex_preprocess_state);
 }
 
-void *denoise_speex_tilde_new (t_floatarg frame_size, t_floatarg sample_rate, t_floatarg max_noise_attenuation) {
+void *denoise_speex_tilde_new (t_floatarg frame_size, t_floatarg sample_rate, t_floatarg max_noise_attenuation, t_floatarg resampler_quality, t_floatarg channels) {
   t_denoise_speex_tilde *x = (t_denoise_speex_tilde *) pd_new (denoise_speex_tilde_class);
 
   if ((int) frame_size != 80 && (int) frame_size != 160 && (int) frame_size != 240 && (int) frame_size != 320 && (int) frame_size != 640) {
@@ -125,19 +123,36 @@ void *denoise_speex_tilde_new (t_floatarg frame_size, t_floatarg sample_rate, t_
     max_noise_attenuation = -15;
   }
 
-  x->speex_preprocess_state = NULL;
+  if ((int) resampler_quality < 0 || (int) resampler_quality > 2) {
+    error ("denoise_speex~: invalid resampler quality specified (%d). Using 0 (medium).", (int) resampler_quality);
+    resampler_quality = RESAMPLER_QUALITY_MEDIUM;
+  }
+
+  if ((int) channels == 0) {
+    channels = 1;               //Default: mono
+  }
+  if ((int) channels < 1 || (int) channels > GENERIC_CODEC_CHANNELS_MAX) {
+    error ("denoise_speex~: invalid number of channels specified (%d). Using 1.", (int) channels);
+    channels = 1;
+  }
+
   x->max_noise_attenuation = max_noise_attenuation;
 
-  generic_codec_init (&x->codec, &x->x_obj, sample_rate, frame_size);
+  generic_codec_init (&x->codec, &x->x_obj, sample_rate, frame_size, resampler_quality, channels, (t_generic_codec_process_frames) denoise_speex_process_frames);
+
+  x->speex_preprocess_state = calloc (x->codec.channels, sizeof (void *));
 
-  post ("denoise_speex~: Created with frame size (%d), sampling rate (%f) and max. noise attenuation (%d).", x->codec.frame_size, x->codec.sample_rate_internal, x->max_noise_attenuation);
+  post ("denoise_speex~: Created with frame size (%d), sampling rate (%f) and max. noise attenuation (%d) for %d channel(s).", x->codec.frame_size, x->codec.sample_rate_internal, x->max_noise_attenuation, x->codec.channels);
 
   return (void *) x;
 }
 
 void denoise_speex_tilde_setup (void) {
-  denoise_speex_tilde_class = class_new (gensym ("denoise_speex~"), (t_newmethod) denoise_speex_tilde_new, (t_method) denoise_speex_tilde_free, sizeof (t_denoise_speex_tilde), CLASS_DEFAULT, A_DEFFLOAT, A_DEFFLOAT, A_DEFFLOAT, 0);
+  denoise_speex_tilde_class = class_new (gensym ("denoise_speex~"), (t_newmethod) denoise_speex_tilde_new, (t_method) denoise_speex_tilde_free, sizeof (t_denoise_speex_tilde), CLASS_DEFAULT, A_DEFFLOAT, A_DEFFLOAT, A_DEFFLOAT, A_DEFFLOAT, A_DEFFLOAT, 0);
   class_addmethod (denoise_speex_tilde_class, (t_method) denoise_speex_tilde_dsp, gensym ("dsp"), 0);
+  class_addmethod (denoise_speex_tilde_class, (t_method) denoise_speex_latency, gensym ("latency"), 0);
+  class_addmethod (denoise_speex_tilde_class, (t_method) denoise_speex_worker, gensym ("worker"), A_FLOAT, 0);
+  class_addmethod (denoise_speex_tilde_class, (t_method) denoise_speex_phase, gensym ("phase"), A_FLOAT, 0);
   CLASS_MAINSIGNALIN (denoise_speex_tilde_class, t_denoise_speex_tilde, float_inlet);
   class_sethelpsymbol (denoise_speex_tilde_class, gensym ("denoise_speex~"));
 }
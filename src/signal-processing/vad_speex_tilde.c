@@ -7,9 +7,10 @@
 vad_speex~ applies the _voice activity detection_ algorithm of [Speex](http://www.speex.org/).
 
 Parameters:
-  vad_speex~ FRAME_SIZE SAMPLE_RATE
+  vad_speex~ FRAME_SIZE SAMPLE_RATE RESAMPLER_QUALITY
   FRAME_SIZE in samples: 80, 160, 240, 320
   SAMPLE_RATE in  Hz: 8000, 16000, 32000
+  RESAMPLER_QUALITY: 0 (medium) [default], 1 (low latency), 2 (high)
 
 Inlets:
   1x Audio inlet
@@ -20,16 +21,18 @@ Outlets:
 
 Developer note:
 resampler_output and ringbuffer_output provided by generic_codec are not used.
+Developer note: process_frames only counts the frames with voice activity; the perform-routine sends the bangs (PureData's API).
+Developer note: vad_speex~ is mono (one channel), as the VAD result is reported by a single bang outlet.
 
 @see denoise_speex_tilde.c
 */
 
 #include <m_pd.h>
-#include <limits.h>
 #include <stdbool.h>
 #include <string.h>
 #include "ringbuffer.h"
 #include "generic_codec.h"
+#include "convert.h"
 
 #include "speex/speex.h"
 #include "speex/speex_preprocess.h"
@@ -46,45 +49,44 @@ typedef struct _vad_speex_tilde {
   void *speex_preprocess_state;
 
   t_outlet *outlet_bang_vad;
+  unsigned int voice_frames;    //Frames with voice activity (set by process_frames; one bang each)
 
 } t_vad_speex_tilde;
 
-void vad_speex_add_to_outbuffer (t_vad_speex_tilde * x);
+void vad_speex_process_frames (t_vad_speex_tilde * x, unsigned int channel, unsigned int n, float *frames) {
+  (void) channel;               //Mono
+  unsigned int frame_size = x->codec.frame_size;
+
+  for (unsigned int f = 0; f < n; f++) {
+    float *frame = &frames[f * frame_size];
+
+    short raw[frame_size];
+    convert_float_to_short (frame, raw, frame_size);
+
+    if (speex_preprocess_run (x->speex_preprocess_state, raw)) {
+      x->voice_frames++;
+    }
+  }
+}
 
 t_int *vad_speex_tilde_perform (t_int * w) {
   t_vad_speex_tilde *x = (t_vad_speex_tilde *) (w[1]);
-  t_sample *in = (t_sample *) (w[2]);
-  t_sample *out = (t_sample *) (w[3]);
-  int n = (int) (w[4]);
+  int n = (int) (w[2]);
+  t_sample *in = (t_sample *) (w[3]);
+  t_sample *out = (t_sample *) (w[4]);
+
+  x->voice_frames = 0;
+  generic_codec_process_input (&x->codec, n, &in);
 
-  generic_codec_resample_to_internal (&x->codec, n, in);
-  if (float_buffer_has_chunk (x->codec.ringbuffer_input)) {
-    vad_speex_add_to_outbuffer (x);
-  }
   //Passthrough incoming signal
   for (int i = 0; i < n; i++) {
     out[i] = in[i];
   }
-  return (w + 5);
-}
 
-void vad_speex_add_to_outbuffer (t_vad_speex_tilde * x) {
-  bool free_required = false;
-  float *frame;
-  float_buffer_pop_chunk (x->codec.ringbuffer_input, &frame, x->codec.ringbuffer_input->chunk_size, &free_required);
-
-  short raw[x->codec.ringbuffer_input->chunk_size];
-  for (int i = 0; i < x->codec.ringbuffer_input->chunk_size; i++) {
-    raw[i] = SHRT_MAX * frame[i];
-  }
-
-  if (speex_preprocess_run (x->speex_preprocess_state, raw)) {
+  for (unsigned int i = 0; i < x->voice_frames; i++) {
     outlet_bang (x->outlet_bang_vad);
   }
-
-  if (free_required) {
-    free (frame);
-  }
+  return (w + 5);
 }
 
 void vad_speex_tilde_dsp (t_vad_speex_tilde * x, t_signal ** sp) {
@@ -106,7 +108,7 @@ void vad_speex_tilde_free (t_vad_speex_tilde * x) {
   outlet_free (x->outlet_bang_vad);
 }
 
-void *vad_speex_tilde_new (t_floatarg frame_size, t_floatarg sample_rate) {
+void *vad_speex_tilde_new (t_floatarg frame_size, t_floatarg sample_rate, t_floatarg resampler_quality) {
   t_vad_speex_tilde *x = (t_vad_speex_tilde *) pd_new (vad_speex_tilde_class);
 
   if ((int) frame_size != 80 && (int) frame_size != 160 && (int) frame_size != 240 && (int) frame_size != 320) {
@@ -119,9 +121,14 @@ void *vad_speex_tilde_new (t_floatarg frame_size, t_floatarg sample_rate) {
     sample_rate = 8000;
   }
 
+  if ((int) resampler_quality < 0 || (int) resampler_quality > 2) {
+    error ("vad_speex~: invalid resampler quality specified (%d). Using 0 (medium).", (int) resampler_quality);
+    resampler_quality = RESAMPLER_QUALITY_MEDIUM;
+  }
+
   x->speex_preprocess_state = NULL;
 
-  generic_codec_init (&x->codec, &x->x_obj, sample_rate, frame_size);
+  generic_codec_init (&x->codec, &x->x_obj, sample_rate, frame_size, resampler_quality, 1, (t_generic_codec_process_frames) vad_speex_process_frames);
 
   x->outlet_bang_vad = outlet_new (&x->x_obj, &s_bang);
 
@@ -131,7 +138,7 @@ void *vad_speex_tilde_new (t_floatarg frame_size, t_floatarg sample_rate) {
 }
 
 void vad_speex_tilde_setup (void) {
-  vad_speex_tilde_class = class_new (gensym ("vad_speex~"), (t_newmethod) vad_speex_tilde_new, (t_method) vad_speex_tilde_free, sizeof (t_vad_speex_tilde), CLASS_DEFAULT, A_DEFFLOAT, A_DEFFLOAT, 0);
+  vad_speex_tilde_class = class_new (gensym ("vad_speex~"), (t_newmethod) vad_speex_tilde_new, (t_method) vad_speex_tilde_free, sizeof (t_vad_speex_tilde), CLASS_DEFAULT, A_DEFFLOAT, A_DEFFLOAT, A_DEFFLOAT, 0);
   class_addmethod (vad_speex_tilde_class, (t_method) vad_speex_tilde_dsp, gensym ("dsp"), 0);
   CLASS_MAINSIGNALIN (vad_speex_tilde_class, t_vad_speex_tilde, float_inlet_unused);
   class_sethelpsymbol (vad_speex_tilde_class, gensym ("vad_speex~"));
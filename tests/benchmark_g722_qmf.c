@@ -0,0 +1,192 @@
+/**
+@file benchmark_g722_qmf.c
+@author Frank Haase, Dennis Guse
+@date 2026-10-16
+@license GPLv3 or later
+
+Compares the vectorized QMF of G.722 (third-party/spanddsp_g722/g722_qmf.h) with the original implementation of spandsp (shifting the history per pair of samples).
+First, the outputs and the history of both are compared (bit-exact; random signal and several frame sizes), then both are timed.
+The receive QMF is compared via g722_decode(): a second decoder in ITU test mode outputs the sub-band signals without QMF, to which the original receive QMF is applied (random codes; all bit rates).
+Finally, the throughput of the codec (g722_encode() and g722_decode()) is measured.
+
+Returns 0 if both implementations are identical (transmit and receive QMF).
+
+Usage:
+  benchmark_g722_qmf [FRAMES]
+
+  FRAMES: number of frames (320 samples) per measurement (default: 100000)
+
+*/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "g722.h"
+#include "g722_qmf.h"
+
+#define FRAME_SIZE 320
+
+//Original implementation (g722_encode.c): transmit QMF.
+static void reference_analysis (int x[24], const int16_t amp[], int len, int32_t sumodd[], int32_t sumeven[]) {
+  for (int j = 0, k = 0; j < len; k++) {
+    for (int i = 0; i < 22; i++) {
+      x[i] = x[i + 2];
+    }
+    x[22] = amp[j++];
+    x[23] = amp[j++];
+
+    sumodd[k] = 0;
+    sumeven[k] = 0;
+    for (int i = 0; i < 12; i++) {
+      sumodd[k] += x[2 * i] * g722_qmf_coeffs[i];
+      sumeven[k] += x[2 * i + 1] * g722_qmf_coeffs[11 - i];
+    }
+  }
+}
+
+//Original implementation (g722_decode.c): receive QMF; bands contains pairs of rlow << 1 and rhigh << 1 (ITU test mode).
+static void reference_synthesis (int x[24], const int16_t bands[], int len, int16_t amp[]) {
+  for (int j = 0; j < len; j += 2) {
+    int rlow = bands[j] >> 1;
+    int rhigh = bands[j + 1] >> 1;
+
+    for (int i = 0; i < 22; i++) {
+      x[i] = x[i + 2];
+    }
+    x[22] = rlow + rhigh;
+    x[23] = rlow - rhigh;
+
+    int32_t xout1 = 0;
+    int32_t xout2 = 0;
+    for (int i = 0; i < 12; i++) {
+      xout2 += x[2 * i] * g722_qmf_coeffs[i];
+      xout1 += x[2 * i + 1] * g722_qmf_coeffs[11 - i];
+    }
+    amp[j] = (int16_t) (xout1 >> 11);
+    amp[j + 1] = (int16_t) (xout2 >> 11);
+  }
+}
+
+//Compares the output of g722_decode() (vectorized receive QMF) with the original receive QMF; returns the number of frames that differ.
+static unsigned int compare_synthesis (int rate) {
+  g722_decode_state_t decoder;
+  g722_decode_state_t bands_decoder;
+  g722_decode_init (&decoder, rate, 0);
+  g722_decode_init (&bands_decoder, rate, 0);
+  bands_decoder.itu_test_mode = 1;
+  int x[24];
+  memset (x, 0, sizeof (x));
+
+  uint8_t encoded[FRAME_SIZE / 2];
+  int16_t bands[FRAME_SIZE];
+  int16_t decoded[2][FRAME_SIZE];
+  unsigned int mismatches = 0;
+  for (unsigned int f = 0; f < 10000; f++) {
+    int len = 1 + rand () % (FRAME_SIZE / 2);
+    for (int i = 0; i < len; i++) {
+      encoded[i] = (uint8_t) (rand () % 256);
+    }
+    int decoded_length = g722_decode (&decoder, decoded[1], encoded, len);
+    int bands_length = g722_decode (&bands_decoder, bands, encoded, len);
+    reference_synthesis (x, bands, bands_length, decoded[0]);
+    if (decoded_length != bands_length || memcmp (decoded[0], decoded[1], decoded_length * sizeof (int16_t)) != 0 || memcmp (x, decoder.x, sizeof (x)) != 0) {
+      mismatches++;
+    }
+  }
+  return mismatches;
+}
+
+//Vectorized implementation: transmit QMF (as in g722_encode.c).
+static void vectorized_analysis (int x[24], const int16_t amp[], int len, int32_t sumodd[], int32_t sumeven[]) {
+  int16_t buf[G722_QMF_HISTORY + 2 * G722_QMF_CHUNK];
+  for (int j = 0; j < len;) {
+    int pairs = (len - j) >> 1;
+    if (pairs > G722_QMF_CHUNK) {
+      pairs = G722_QMF_CHUNK;
+    }
+    g722_qmf_load (x, buf);
+    memcpy (&buf[G722_QMF_HISTORY], &amp[j], 2 * pairs * sizeof (int16_t));
+    g722_qmf_filter (buf, pairs, &sumodd[j / 2], &sumeven[j / 2]);
+    g722_qmf_store (x, buf, pairs);
+    j += 2 * pairs;
+  }
+}
+
+static double now_ms () {
+  struct timespec time;
+  clock_gettime (CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+}
+
+int main (int argc, char **argv) {
+  unsigned int frames = argc > 1 ? atoi (argv[1]) : 100000;
+
+  int16_t signal[FRAME_SIZE];
+  int32_t sumodd[2][FRAME_SIZE / 2];
+  int32_t sumeven[2][FRAME_SIZE / 2];
+  int x[2][24];
+  memset (x, 0, sizeof (x));
+
+  //Comparison
+  srand (0);
+  unsigned int mismatches = 0;
+  for (unsigned int f = 0; f < 10000; f++) {
+    int len = 2 * (1 + rand () % (FRAME_SIZE / 2));
+    for (int i = 0; i < len; i++) {
+      signal[i] = (int16_t) (rand () % 65536 - 32768);
+    }
+    reference_analysis (x[0], signal, len, sumodd[0], sumeven[0]);
+    vectorized_analysis (x[1], signal, len, sumodd[1], sumeven[1]);
+    if (memcmp (sumodd[0], sumodd[1], len / 2 * sizeof (int32_t)) != 0 || memcmp (sumeven[0], sumeven[1], len / 2 * sizeof (int32_t)) != 0 || memcmp (x[0], x[1], sizeof (x[0])) != 0) {
+      mismatches++;
+    }
+  }
+  printf ("Comparison (transmit QMF): %u of 10000 frames differ.\n", mismatches);
+
+  const int rates[] = { 64000, 56000, 48000 };
+  for (unsigned int r = 0; r < sizeof (rates) / sizeof (rates[0]); r++) {
+    unsigned int synthesis_mismatches = compare_synthesis (rates[r]);
+    printf ("Comparison (receive QMF, g722_decode() at %dbit/s): %u of 10000 frames differ.\n", rates[r], synthesis_mismatches);
+    mismatches += synthesis_mismatches;
+  }
+
+  //Timing: QMF only (checksum: prevents that the results are optimized away)
+  int32_t checksum = 0;
+  double start = now_ms ();
+  for (unsigned int f = 0; f < frames; f++) {
+    reference_analysis (x[0], signal, FRAME_SIZE, sumodd[0], sumeven[0]);
+    checksum += sumodd[0][f % (FRAME_SIZE / 2)] - sumeven[0][f % (FRAME_SIZE / 2)];
+  }
+  double reference_ms = now_ms () - start;
+
+  start = now_ms ();
+  for (unsigned int f = 0; f < frames; f++) {
+    vectorized_analysis (x[1], signal, FRAME_SIZE, sumodd[1], sumeven[1]);
+    checksum -= sumodd[1][f % (FRAME_SIZE / 2)] - sumeven[1][f % (FRAME_SIZE / 2)];
+  }
+  double vectorized_ms = now_ms () - start;
+  printf ("QMF (%u frames of %d samples): original %.1fms, vectorized %.1fms (speedup %.2f; checksum %d).\n", frames, FRAME_SIZE, reference_ms, vectorized_ms, reference_ms / vectorized_ms, checksum);
+
+  //Timing: codec (64kbit/s)
+  g722_encode_state_t encoder;
+  g722_decode_state_t decoder;
+  g722_encode_init (&encoder, 64000, 0);
+  g722_decode_init (&decoder, 64000, 0);
+  uint8_t encoded[FRAME_SIZE];
+  int16_t decoded[FRAME_SIZE];
+
+  start = now_ms ();
+  for (unsigned int f = 0; f < frames; f++) {
+    int encoded_length = g722_encode (&encoder, encoded, signal, FRAME_SIZE);
+    g722_decode (&decoder, decoded, encoded, encoded_length);
+    checksum += decoded[f % FRAME_SIZE];
+  }
+  double codec_ms = now_ms () - start;
+  printf ("Codec (%u frames of %d samples): %.1fms (%.0fx real-time; checksum %d).\n", frames, FRAME_SIZE, codec_ms, frames * (FRAME_SIZE / 16.0) / codec_ms, checksum);
+
+  return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+/**
+@file benchmark_lpc10.c
+@author Frank Haase, Dennis Guse
+@date 2026-10-16
+@license GPLv3 or later
+
+Measures the throughput of LPC-10 (third-party/lpc10) on contiguous multi-frame input (lpc10_encode_frames() and lpc10_decode_frames()).
+The input is a synthetic, speech-like signal (harmonics with varying pitch, noise, and pauses; deterministic).
+
+Prints a checksum (FNV-1a) of the encoded bits and of the decoded signal, so changes of the codec can be checked for bit-exactness.
+
+Usage:
+  benchmark_lpc10 [FRAMES] [BATCH]
+
+  FRAMES: number of frames (180 samples) (default: 20000)
+  BATCH: number of frames per call (default: 8)
+
+*/
+
+#define _XOPEN_SOURCE 600      //clock_gettime() and M_PI
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "lpc10.h"
+
+static double now_ms () {
+  struct timespec time;
+  clock_gettime (CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+}
+
+static uint32_t fnv1a (uint32_t hash, const void *data, size_t size) {
+  const uint8_t *bytes = data;
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+int main (int argc, char **argv) {
+  int frames = argc > 1 ? atoi (argv[1]) : 20000;
+  int batch = argc > 2 ? atoi (argv[2]) : 8;
+  if (frames < 1 || batch < 1) {
+    fprintf (stderr, "Invalid number of frames or batch size.\n");
+    return 1;
+  }
+  frames = (frames + batch - 1) / batch * batch;
+
+  //Synthetic speech-like signal (8kHz)
+  float *speech = malloc (frames * LPC10_SAMPLES_PER_FRAME * sizeof (float));
+  INT32 *bits = malloc (frames * LPC10_BITS_IN_COMPRESSED_FRAME * sizeof (INT32));
+  uint32_t noise = 1;
+  double phase = 0;
+  for (int i = 0; i < frames * LPC10_SAMPLES_PER_FRAME; i++) {
+    double pitch = 120 + 40 * sin (2 * M_PI * i / 24000.0);
+    phase += 2 * M_PI * pitch / 8000;
+    double voiced = 0;
+    for (int h = 1; h * pitch < 3500; h++) {
+      voiced += sin (h * phase) / h;
+    }
+    noise = noise * 1664525u + 1013904223u;
+    double unvoiced = (double) noise / UINT32_MAX - 0.5;
+    double envelope = fmax (0, sin (2 * M_PI * i / 12000.0));       //Pauses
+    speech[i] = (float) (envelope * (0.3 * voiced + 0.05 * unvoiced));
+  }
+
+  struct lpc10_encoder_state encoder;
+  struct lpc10_decoder_state decoder;
+  init_lpc10_encoder_state (&encoder);
+  init_lpc10_decoder_state (&decoder);
+
+  double start = now_ms ();
+  for (int f = 0; f < frames; f += batch) {
+    lpc10_encode_frames (&speech[f * LPC10_SAMPLES_PER_FRAME], &bits[f * LPC10_BITS_IN_COMPRESSED_FRAME], batch, &encoder);
+  }
+  double encode_ms = now_ms () - start;
+
+  start = now_ms ();
+  for (int f = 0; f < frames; f += batch) {
+    lpc10_decode_frames (&bits[f * LPC10_BITS_IN_COMPRESSED_FRAME], &speech[f * LPC10_SAMPLES_PER_FRAME], batch, &decoder);
+  }
+  double decode_ms = now_ms () - start;
+
+  double duration_ms = frames * (LPC10_SAMPLES_PER_FRAME / 8.0);
+  printf ("Encoder (%d frames, %d per call): %.1fms (%.0fx real-time).\n", frames, batch, encode_ms, duration_ms / encode_ms);
+  printf ("Decoder (%d frames, %d per call): %.1fms (%.0fx real-time).\n", frames, batch, decode_ms, duration_ms / decode_ms);
+  printf ("Checksum: bits %08x, decoded %08x.\n", fnv1a (2166136261u, bits, frames * LPC10_BITS_IN_COMPRESSED_FRAME * sizeof (INT32)), fnv1a (2166136261u, speech, frames * LPC10_SAMPLES_PER_FRAME * sizeof (float)));
+
+  free (speech);
+  free (bits);
+  return 0;
+}
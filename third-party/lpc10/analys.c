@@ -44,6 +44,7 @@ extern int analys_(real *speech, integer *voice, integer *pitch, real *rms, real
 */
 
 #include "f2c.h"
+#include <string.h>
 
 /* Common Block Declarations */
 
@@ -427,19 +428,17 @@ static integer c__1 = 1;
     rcbuf = &(st->rcbuf[0]);
     zpre = &(st->zpre);
 
-    i__1 = 720 - contrl_1.lframe;
-    for (i__ = 181; i__ <= i__1; ++i__) {
-	inbuf[i__ - 181] = inbuf[contrl_1.lframe + i__ - 181];
-	pebuf[i__ - 181] = pebuf[contrl_1.lframe + i__ - 181];
-    }
-    i__1 = 540 - contrl_1.lframe;
-    for (i__ = 229; i__ <= i__1; ++i__) {
-	ivbuf[i__ - 229] = ivbuf[contrl_1.lframe + i__ - 229];
-    }
-    i__1 = 720 - contrl_1.lframe;
-    for (i__ = 25; i__ <= i__1; ++i__) {
-	lpbuf[i__ - 25] = lpbuf[contrl_1.lframe + i__ - 25];
-    }
+/*       Shift by one frame (block copies instead of element loops): */
+/*       INBUF and PEBUF(181:720-LFRAME), IVBUF(229:540-LFRAME), */
+/*       LPBUF(25:720-LFRAME). */
+    memmove(inbuf, &inbuf[contrl_1.lframe], (540 - contrl_1.lframe) * 
+	    sizeof(real));
+    memmove(pebuf, &pebuf[contrl_1.lframe], (540 - contrl_1.lframe) * 
+	    sizeof(real));
+    memmove(ivbuf, &ivbuf[contrl_1.lframe], (312 - contrl_1.lframe) * 
+	    sizeof(real));
+    memmove(lpbuf, &lpbuf[contrl_1.lframe], (696 - contrl_1.lframe) * 
+	    sizeof(real));
     j = 1;
     i__1 = (*osptr) - 1;
     for (i__ = 1; i__ <= i__1; ++i__) {
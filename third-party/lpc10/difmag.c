@@ -19,6 +19,12 @@ extern int difmag_(real *speech, integer *lpita, integer *tau, integer *ltau, in
 #include "f2c.h"
 #include <math.h>
 
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 /* ********************************************************************** */
 
 /* 	DIFMAG Version 49 */
@@ -64,47 +70,91 @@ extern int difmag_(real *speech, integer *lpita, integer *tau, integer *ltau, in
 
 /* This subroutine has no local state. */
 
+/* Rewritten (0-based, no f2c temporaries): four lags are computed at */
+/* once (SIMD); each lag is summed in the same order as before, so */
+/* the result is bit-exact.  Independent sums also avoid the latency */
+/* of one long chain of dependent additions. */
+
+/* Sums |speech[i] - speech[i + tau]| over every 4th sample of four */
+/* lags; start[k] points to the first sample of lag k. */
+static void difmag4_(const real **start, const integer *tau, integer n,
+	real *amdf)
+{
+    integer k, m;
+
+#if defined(__SSE__)
+    const __m128 sign = _mm_set1_ps(-0.f);
+    __m128 sum = _mm_setzero_ps();
+    for (m = 0; m < n; m += 4) {
+	__m128 a = _mm_setr_ps(start[0][m], start[1][m], start[2][m],
+		start[3][m]);
+	__m128 b = _mm_setr_ps(start[0][m + tau[0]], start[1][m + tau[1]],
+		start[2][m + tau[2]], start[3][m + tau[3]]);
+	sum = _mm_add_ps(sum, _mm_andnot_ps(sign, _mm_sub_ps(a, b)));
+    }
+    _mm_storeu_ps(amdf, sum);
+#elif defined(__ARM_NEON)
+    float32x4_t sum = vdupq_n_f32(0.f);
+    for (m = 0; m < n; m += 4) {
+	float32x4_t a = { start[0][m], start[1][m], start[2][m],
+		start[3][m] };
+	float32x4_t b = { start[0][m + tau[0]], start[1][m + tau[1]],
+		start[2][m + tau[2]], start[3][m + tau[3]] };
+	sum = vaddq_f32(sum, vabsq_f32(vsubq_f32(a, b)));
+    }
+    vst1q_f32(amdf, sum);
+#else
+    real sum[4] = { 0.f, 0.f, 0.f, 0.f };
+    for (m = 0; m < n; m += 4) {
+	for (k = 0; k < 4; ++k) {
+	    sum[k] += fabsf(start[k][m] - start[k][m + tau[k]]);
+	}
+    }
+    for (k = 0; k < 4; ++k) {
+	amdf[k] = sum[k];
+    }
+#endif
+    (void) k;
+}
+
 /* Subroutine */ int difmag_(real *speech, integer *lpita, integer *tau, 
 	integer *ltau, integer *maxlag, real *amdf, integer *minptr, integer *
 	maxptr)
 {
-    /* System generated locals */
-    integer i__1, i__2;
-    real r__1;
-
-    /* Local variables */
-    integer i__, j, n1, n2;
-    real sum;
-
-/*       Arguments */
-/*       Local variables that need not be saved */
-/*       Local state */
-/*       None */
-    /* Parameter adjustments */
-    --amdf;
-    --tau;
-    --speech;
-
-    /* Function Body */
+    integer i, k, m, n = *lpita, count = *ltau;
+    const real *start[4];
+    integer lag[4];
+    real sum[4];
+
+    /* Lag i: samples (MAXLAG - TAU(I))/2 + 1 (1-based) to that + LPITA-1 */
+    for (i = 0; i + 4 <= count; i += 4) {
+	for (k = 0; k < 4; ++k) {
+	    start[k] = &speech[(*maxlag - tau[i + k]) / 2];
+	}
+	difmag4_(start, &tau[i], n, &amdf[i]);
+    }
+    if (i < count) {
+	/* Remainder: unused lanes repeat the last lag */
+	for (k = 0; k < 4; ++k) {
+	    lag[k] = tau[i + k < count ? i + k : count - 1];
+	    start[k] = &speech[(*maxlag - lag[k]) / 2];
+	}
+	difmag4_(start, lag, n, sum);
+	for (k = 0; i + k < count; ++k) {
+	    amdf[i + k] = sum[k];
+	}
+    }
+
+    /* MINPTR and MAXPTR are 1-based */
     *minptr = 1;
     *maxptr = 1;
-    i__1 = *ltau;
-    for (i__ = 1; i__ <= i__1; ++i__) {
-	n1 = (*maxlag - tau[i__]) / 2 + 1;
-	n2 = n1 + *lpita - 1;
-	sum = 0.f;
-	i__2 = n2;
-	for (j = n1; j <= i__2; j += 4) {
-	    sum += (r__1 = speech[j] - speech[j + tau[i__]], fabsf(r__1));
+    for (m = 1; m < count; ++m) {
+	if (amdf[m] < amdf[*minptr - 1]) {
+	    *minptr = m + 1;
 	}
-	amdf[i__] = sum;
-	if (amdf[i__] < amdf[*minptr]) {
-	    *minptr = i__;
-	}
-	if (amdf[i__] > amdf[*maxptr]) {
-	    *maxptr = i__;
+	if (amdf[m] > amdf[*maxptr - 1]) {
+	    *maxptr = m + 1;
 	}
     }
     return 0;
 } /* difmag_ */
-
@@ -271,7 +271,7 @@ extern struct {
 )*/
 /*   is used to maintain arithmetic precision. */
     if (*voice == 1) {
-	*alphax = *alphax * .75f + amdf[*minptr] / 2.f;
+	*alphax = *alphax * .75f + amdf[*minptr] * .5f;
     } else {
 	*alphax *= .984375f;
     }
@@ -316,13 +316,13 @@ n*/
     }
 /*   Update S using AMDF */
 /*   Find maximum, minimum, and location of minimum */
-    s[0] += amdf[1] / 2;
+    s[0] += amdf[1] * .5f;
     minsc = s[0];
     maxsc = minsc;
     *midx = 1;
     i__1 = *ltau;
     for (i__ = 2; i__ <= i__1; ++i__) {
-	s[i__ - 1] += amdf[i__] / 2;
+	s[i__ - 1] += amdf[i__] * .5f;
 	if (s[i__ - 1] > maxsc) {
 	    maxsc = s[i__ - 1];
 	}
@@ -341,7 +341,7 @@ n*/
     j = 0;
     for (i__ = 20; i__ <= 40; i__ += 10) {
 	if (*midx > i__) {
-	    if (s[*midx - i__ - 1] < maxsc / 4) {
+	    if (s[*midx - i__ - 1] < maxsc * .25f) {
 		j = i__;
 	    }
 	}
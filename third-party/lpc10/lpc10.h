@@ -190,14 +190,22 @@ struct lpc10_decoder_state {
   array speech[] is written (indices 0 through
   (LPC10_SAMPLES_PER_FRAME-1)).
 
+  lpc10_encode_frames and lpc10_decode_frames process n consecutive
+  frames at once: speech[] holds n*LPC10_SAMPLES_PER_FRAME samples and
+  bits[] n*LPC10_BITS_IN_COMPRESSED_FRAME bits (contiguous).  The
+  result is identical to calling lpc10_encode or lpc10_decode for each
+  frame.
+
   */
 
 struct lpc10_encoder_state * create_lpc10_encoder_state ();
 void init_lpc10_encoder_state (struct lpc10_encoder_state *st);
 int lpc10_encode (real *speech, INT32 *bits, struct lpc10_encoder_state *st);
+int lpc10_encode_frames (real *speech, INT32 *bits, INT32 n, struct lpc10_encoder_state *st);
 
 struct lpc10_decoder_state * create_lpc10_decoder_state ();
 void init_lpc10_decoder_state (struct lpc10_decoder_state *st);
 int lpc10_decode (INT32 *bits, real *speech, struct lpc10_decoder_state *st);
+int lpc10_decode_frames (INT32 *bits, real *speech, INT32 n, struct lpc10_decoder_state *st);
 
 #endif /* __LPC10_H__ */
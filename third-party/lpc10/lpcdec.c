@@ -247,3 +247,19 @@ static integer c__10 = 10;
     synths_(voice, &pitch, &rms, rc, &speech[1], &len, st);
     return 0;
 } /* lpcdec_ */
+
+/* Decode n consecutive frames: bits[] holds */
+/* n*LPC10_BITS_IN_COMPRESSED_FRAME bits, speech[] receives */
+/* n*LPC10_SAMPLES_PER_FRAME samples.  Identical to calling */
+/* lpc10_decode for each frame. */
+int lpc10_decode_frames(integer *bits, real *speech, integer n,
+			struct lpc10_decoder_state *st)
+{
+    integer i;
+
+    for (i = 0; i < n; ++i) {
+	lpc10_decode(&bits[i * LPC10_BITS_IN_COMPRESSED_FRAME],
+		&speech[i * LPC10_SAMPLES_PER_FRAME], st);
+    }
+    return 0;
+} /* lpc10_decode_frames */
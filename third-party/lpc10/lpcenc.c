@@ -143,3 +143,19 @@ static integer c__10 = 10;
     chanwr_(&c__10, &ipitv, &irms, irc, &bits[1], st);
     return 0;
 } /* lpcenc_ */
+
+/* Encode n consecutive frames: speech[] holds n*LPC10_SAMPLES_PER_FRAME */
+/* samples (modified as by lpc10_encode), bits[] receives */
+/* n*LPC10_BITS_IN_COMPRESSED_FRAME bits.  Identical to calling */
+/* lpc10_encode for each frame. */
+int lpc10_encode_frames(real *speech, integer *bits, integer n,
+			struct lpc10_encoder_state *st)
+{
+    integer i;
+
+    for (i = 0; i < n; ++i) {
+	lpc10_encode(&speech[i * LPC10_SAMPLES_PER_FRAME],
+		&bits[i * LPC10_BITS_IN_COMPRESSED_FRAME], st);
+    }
+    return 0;
+} /* lpc10_encode_frames */
@@ -18,6 +18,12 @@ extern int lpfilt_(real *inbuf, real *lpbuf, integer *len, integer *nsamp);
 
 #include "f2c.h"
 
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 /* *********************************************************************** */
 
 /* 	LPFILT Version 55 */
@@ -56,46 +62,57 @@ extern int lpfilt_(real *inbuf, real *lpbuf, integer *len, integer *nsamp);
 
 /* This subroutine has no local state. */
 
+/* Rewritten (0-based, symmetric coefficients in a table): four outputs */
+/* are computed at once (SIMD), each with the same operations in the */
+/* same order as before, so the result is bit-exact. */
+
+static const real lpfilt_coef[16] = { -.0097201988f,-.0105179986f,
+	-.0083479648f,5.860774e-4f,.0130892089f,.0217052232f,.0184161253f,
+	3.39723e-4f,-.0260797087f,-.0455563702f,-.040306855f,5.029835e-4f,
+	.0729262903f,.1572008878f,.2247288674f,.250535965f };
+
 /* Subroutine */ int lpfilt_(real *inbuf, real *lpbuf, integer *len, integer *
 	nsamp)
 {
-    /* System generated locals */
-    integer i__1;
-
-    /* Local variables */
-    integer j;
+    integer j, k, end = *len;
     real t;
 
-/* 	Arguments */
-/* 	Parameters/constants */
-/*       Local variables that need not be saved */
-/*       Local state */
-/*       None */
-    /* Parameter adjustments */
-    --lpbuf;
-    --inbuf;
-
-    /* Function Body */
-    i__1 = *len;
-    for (j = *len + 1 - *nsamp; j <= i__1; ++j) {
-	t = (inbuf[j] + inbuf[j - 30]) * -.0097201988f;
-	t += (inbuf[j - 1] + inbuf[j - 29]) * -.0105179986f;
-	t += (inbuf[j - 2] + inbuf[j - 28]) * -.0083479648f;
-	t += (inbuf[j - 3] + inbuf[j - 27]) * 5.860774e-4f;
-	t += (inbuf[j - 4] + inbuf[j - 26]) * .0130892089f;
-	t += (inbuf[j - 5] + inbuf[j - 25]) * .0217052232f;
-	t += (inbuf[j - 6] + inbuf[j - 24]) * .0184161253f;
-	t += (inbuf[j - 7] + inbuf[j - 23]) * 3.39723e-4f;
-	t += (inbuf[j - 8] + inbuf[j - 22]) * -.0260797087f;
-	t += (inbuf[j - 9] + inbuf[j - 21]) * -.0455563702f;
-	t += (inbuf[j - 10] + inbuf[j - 20]) * -.040306855f;
-	t += (inbuf[j - 11] + inbuf[j - 19]) * 5.029835e-4f;
-	t += (inbuf[j - 12] + inbuf[j - 18]) * .0729262903f;
-	t += (inbuf[j - 13] + inbuf[j - 17]) * .1572008878f;
-	t += (inbuf[j - 14] + inbuf[j - 16]) * .2247288674f;
-	t += inbuf[j - 15] * .250535965f;
+    /* INBUF(J) is inbuf[j - 1] */
+    j = *len - *nsamp;
+#if defined(__SSE__)
+    for (; j + 4 <= end; j += 4) {
+	const real *in = &inbuf[j];
+	__m128 v = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(in), _mm_loadu_ps(in - 30)),
+		_mm_set1_ps(lpfilt_coef[0]));
+	for (k = 1; k < 15; ++k) {
+	    v = _mm_add_ps(v, _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(in - k),
+		    _mm_loadu_ps(in - 30 + k)), _mm_set1_ps(lpfilt_coef[k])));
+	}
+	v = _mm_add_ps(v, _mm_mul_ps(_mm_loadu_ps(in - 15),
+		_mm_set1_ps(lpfilt_coef[15])));
+	_mm_storeu_ps(&lpbuf[j], v);
+    }
+#elif defined(__ARM_NEON)
+    for (; j + 4 <= end; j += 4) {
+	const real *in = &inbuf[j];
+	float32x4_t v = vmulq_n_f32(vaddq_f32(vld1q_f32(in), vld1q_f32(in - 30)),
+		lpfilt_coef[0]);
+	for (k = 1; k < 15; ++k) {
+	    v = vaddq_f32(v, vmulq_n_f32(vaddq_f32(vld1q_f32(in - k),
+		    vld1q_f32(in - 30 + k)), lpfilt_coef[k]));
+	}
+	v = vaddq_f32(v, vmulq_n_f32(vld1q_f32(in - 15), lpfilt_coef[15]));
+	vst1q_f32(&lpbuf[j], v);
+    }
+#endif
+    for (; j < end; ++j) {
+	const real *in = &inbuf[j];
+	t = (in[0] + in[-30]) * lpfilt_coef[0];
+	for (k = 1; k < 15; ++k) {
+	    t += (in[-k] + in[-30 + k]) * lpfilt_coef[k];
+	}
+	t += in[-15] * lpfilt_coef[15];
 	lpbuf[j] = t;
     }
     return 0;
 } /* lpfilt_ */
-
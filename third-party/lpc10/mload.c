@@ -80,6 +80,8 @@ extern int mload_(integer *order, integer *awins, integer *awinf, real *speech,
 
     /* Local variables */
     integer c__, i__, r__, start;
+    real sum[10], last;
+    const real *s;
 
 /*       Arguments */
 /*       Local variables that need not be saved */
@@ -93,20 +95,28 @@ extern int mload_(integer *order, integer *awins, integer *awinf, real *speech,
 
     /* Function Body */
     start = *awins + *order;
+/*   Both in one pass over the window: the sums of all lags are */
+/*   independent (no chain of dependent additions; vectorizable), each */
+/*   is summed in the same order as before (bit-exact). */
+/*   ORDER is at most 10 (as everywhere in LPC-10). */
     i__1 = *order;
     for (r__ = 1; r__ <= i__1; ++r__) {
-	phi[r__ + phi_dim1] = 0.f;
-	i__2 = *awinf;
-	for (i__ = start; i__ <= i__2; ++i__) {
-	    phi[r__ + phi_dim1] += speech[i__ - 1] * speech[i__ - r__];
+	sum[r__ - 1] = 0.f;
+    }
+    last = 0.f;
+    i__2 = *awinf;
+    for (i__ = start; i__ <= i__2; ++i__) {
+	s = &speech[i__ - 1];
+	for (r__ = 1; r__ <= i__1; ++r__) {
+	    sum[r__ - 1] += s[0] * s[1 - r__];
 	}
+	last += s[1] * s[1 - i__1];
     }
-/*   Load last element of vector PSI */
-    psi[*order] = 0.f;
-    i__1 = *awinf;
-    for (i__ = start; i__ <= i__1; ++i__) {
-	psi[*order] += speech[i__] * speech[i__ - *order];
+    for (r__ = 1; r__ <= i__1; ++r__) {
+	phi[r__ + phi_dim1] = sum[r__ - 1];
     }
+/*   Load last element of vector PSI */
+    psi[*order] = last;
 /*   End correct to get additional columns of PHI */
     i__1 = *order;
     for (r__ = 2; r__ <= i__1; ++r__) {
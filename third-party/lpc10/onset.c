@@ -27,10 +27,6 @@ extern int onset_(real *pebuf, integer *osbuf, integer *osptr, integer *oslen, i
 #include "f2c.h"
 #include <math.h>
 
-/* Table of constant values */
-
-static real c_b2 = 1.f;
-
 /* ****************************************************************** */
 
 /* 	ONSET Version 49 */
@@ -107,28 +103,26 @@ static real c_b2 = 1.f;
 	osptr, integer *oslen, integer *sbufl, integer *sbufh, integer *
 	lframe, struct lpc10_encoder_state *st)
 {
-    /* Initialized data */
+    /* Local copies of the state (kept in registers; PEBUF and OSBUF */
+    /* could alias the state for the compiler) */
 
-    real *n;
-    real *d__;
+    real n;
+    real d__;
     real *l2buf;
-    real *l2sum1;
-    integer *l2ptr1;
-    integer *l2ptr2;
-    logical *hyst;
+    real l2sum1;
+    integer l2ptr1;
+    integer l2ptr2;
+    logical hyst;
 
     /* System generated locals */
     integer pebuf_offset, i__1;
     real r__1;
 
-    /* Builtin functions */
-    double r_sign(real *, real *);
-
     /* Local variables */
     integer i__;
-    integer *lasti;
+    integer lasti;
     real l2sum2;
-    real *fpc;
+    real fpc;
 
 /*       Arguments */
 /* $Log: onset.c,v $
@@ -200,15 +194,15 @@ static real c_b2 = 1.f;
 */
 /*       coding more than one distinct audio stream. */
 
-    n = &(st->n);
-    d__ = &(st->d__);
-    fpc = &(st->fpc);
+    n = st->n;
+    d__ = st->d__;
+    fpc = st->fpc;
     l2buf = &(st->l2buf[0]);
-    l2sum1 = &(st->l2sum1);
-    l2ptr1 = &(st->l2ptr1);
-    l2ptr2 = &(st->l2ptr2);
-    lasti = &(st->lasti);
-    hyst = &(st->hyst);
+    l2sum1 = st->l2sum1;
+    l2ptr1 = st->l2ptr1;
+    l2ptr2 = st->l2ptr2;
+    lasti = st->lasti;
+    hyst = st->hyst;
 
     /* Parameter adjustments */
     if (osbuf) {
@@ -224,22 +218,23 @@ static real c_b2 = 1.f;
 /*       The following line subtracted a hard-coded "180" from LASTI, */
 /*       instead of using a variable like LFRAME or a constant like */
 /*       MAXFRM.  I changed it to LFRAME, for "generality". */
-    if (*hyst) {
-	*lasti -= *lframe;
+    if (hyst) {
+	lasti -= *lframe;
     }
     i__1 = *sbufh;
     for (i__ = *sbufh - *lframe + 1; i__ <= i__1; ++i__) {
 /*   Compute FPC; Use old FPC on divide by zero; Clamp FPC to +/- 1. 
 */
-	*n = (pebuf[i__] * pebuf[i__ - 1] + (*n) * 63.f) / 64.f;
+/*       Multiplication by 1/64 is exact (same result as division). */
+	n = (pebuf[i__] * pebuf[i__ - 1] + n * 63.f) * .015625f;
 /* Computing 2nd power */
 	r__1 = pebuf[i__ - 1];
-	*d__ = (r__1 * r__1 + (*d__) * 63.f) / 64.f;
-	if ((*d__) != 0.f) {
-	    if (fabsf(*n) > (*d__)) {
-		*fpc = r_sign(&c_b2, n);
+	d__ = (r__1 * r__1 + d__ * 63.f) * .015625f;
+	if (d__ != 0.f) {
+	    if (fabsf(n) > d__) {
+		fpc = n >= 0.f ? 1.f : -1.f;
 	    } else {
-		*fpc = (*n) / (*d__);
+		fpc = n / d__;
 	    }
 	}
 /*   Filter FPC */
@@ -262,28 +257,36 @@ of */
 /*       L2BUF(L2PTR1) = FPC */
 /*       L2PTR1 = MOD(L2PTR1,L2WID)+1 */
 
-	l2sum2 = l2buf[*l2ptr1 - 1];
-	*l2sum1 = *l2sum1 - l2buf[*l2ptr2 - 1] + *fpc;
-	l2buf[*l2ptr2 - 1] = *l2sum1;
-	l2buf[*l2ptr1 - 1] = *fpc;
-	*l2ptr1 = *l2ptr1 % 16 + 1;
-	*l2ptr2 = *l2ptr2 % 16 + 1;
-	if ((r__1 = *l2sum1 - l2sum2, fabsf(r__1)) > 1.7f) {
-	    if (! (*hyst)) {
+	l2sum2 = l2buf[l2ptr1 - 1];
+	l2sum1 = l2sum1 - l2buf[l2ptr2 - 1] + fpc;
+	l2buf[l2ptr2 - 1] = l2sum1;
+	l2buf[l2ptr1 - 1] = fpc;
+	l2ptr1 = l2ptr1 % 16 + 1;
+	l2ptr2 = l2ptr2 % 16 + 1;
+	if ((r__1 = l2sum1 - l2sum2, fabsf(r__1)) > 1.7f) {
+	    if (! hyst) {
 /*   Ignore if buffer full */
 		if (*osptr <= *oslen) {
 		    osbuf[*osptr] = i__ - 9;
 		    ++(*osptr);
 		}
-		*hyst = TRUE_;
+		hyst = TRUE_;
 	    }
-	    *lasti = i__;
+	    lasti = i__;
 /*       After one onset detection, at least OSHYST sample times m
 ust go */
 /*       by before another is allowed to occur. */
-	} else if ((*hyst) && i__ - *lasti >= 10) {
-	    *hyst = FALSE_;
+	} else if (hyst && i__ - lasti >= 10) {
+	    hyst = FALSE_;
 	}
     }
+    st->n = n;
+    st->d__ = d__;
+    st->fpc = fpc;
+    st->l2sum1 = l2sum1;
+    st->l2ptr1 = l2ptr1;
+    st->l2ptr2 = l2ptr2;
+    st->lasti = lasti;
+    st->hyst = hyst;
     return 0;
 } /* onset_ */
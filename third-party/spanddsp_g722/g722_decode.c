@@ -36,6 +36,7 @@
 #endif
 
 #include "g722.h"
+#include "g722_qmf.h"
 
 #if !defined(FALSE)
 #define FALSE 0
@@ -183,6 +184,23 @@ int g722_decode_release(g722_decode_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+static int g722_qmf_synthesis(g722_decode_state_t *s, int16_t qmf_buf[], int pairs, int16_t amp[])
+{
+    int32_t xout2[G722_QMF_CHUNK];
+    int32_t xout1[G722_QMF_CHUNK];
+    int k;
+
+    g722_qmf_filter(qmf_buf, pairs, xout2, xout1);
+    g722_qmf_store(s->x, qmf_buf, pairs);
+    for (k = 0;  k < pairs;  k++)
+    {
+        amp[2*k] = (int16_t) (xout1[k] >> 11);
+        amp[2*k + 1] = (int16_t) (xout2[k] >> 11);
+    }
+    return 2*pairs;
+}
+/*- End of function --------------------------------------------------------*/
+
 int g722_decode(g722_decode_state_t *s, int16_t amp[], const uint8_t g722_data[], int len)
 {
     static const int wl[8] = {-60, -30, 58, 172, 334, 538, 1198, 3042 };
@@ -235,27 +253,24 @@ int g722_decode(g722_decode_state_t *s, int16_t amp[], const uint8_t g722_data[]
            1688,   1360,   1040,    728,
             432,    136,   -432,   -136
     };
-    static const int qmf_coeffs[12] =
-    {
-           3,  -11,   12,   32, -210,  951, 3876, -805,  362, -156,   53,  -11,
-    };
 
     int dlowt;
     int rlow;
     int ihigh;
     int dhigh;
     int rhigh;
-    int xout1;
-    int xout2;
     int wd1;
     int wd2;
     int wd3;
     int code;
     int outlen;
-    int i;
     int j;
+    /* Vectorized QMF: history and chunk of samples */
+    int16_t qmf_buf[G722_QMF_HISTORY + 2*G722_QMF_CHUNK];
+    int qmf_pairs;
 
     outlen = 0;
+    qmf_pairs = 0;
     rhigh = 0;
     for (j = 0;  j < len;  )
     {
@@ -374,24 +389,21 @@ int g722_decode(g722_decode_state_t *s, int16_t amp[], const uint8_t g722_data[]
             }
             else
             {
-                /* Apply the receive QMF */
-                for (i = 0;  i < 22;  i++)
-                    s->x[i] = s->x[i + 2];
-                s->x[22] = rlow + rhigh;
-                s->x[23] = rlow - rhigh;
-
-                xout1 = 0;
-                xout2 = 0;
-                for (i = 0;  i < 12;  i++)
+                /* Apply the receive QMF (vectorized, see g722_qmf.h): collected for a chunk of sample pairs */
+                if (qmf_pairs == 0)
+                    g722_qmf_load(s->x, qmf_buf);
+                qmf_buf[G722_QMF_HISTORY + 2*qmf_pairs] = (int16_t) (rlow + rhigh);
+                qmf_buf[G722_QMF_HISTORY + 2*qmf_pairs + 1] = (int16_t) (rlow - rhigh);
+                if (++qmf_pairs == G722_QMF_CHUNK)
                 {
-                    xout2 += s->x[2*i]*qmf_coeffs[i];
-                    xout1 += s->x[2*i + 1]*qmf_coeffs[11 - i];
+                    outlen += g722_qmf_synthesis(s, qmf_buf, qmf_pairs, &amp[outlen]);
+                    qmf_pairs = 0;
                 }
-                amp[outlen++] = (int16_t) (xout1 >> 11);
-                amp[outlen++] = (int16_t) (xout2 >> 11);
             }
         }
     }
+    if (qmf_pairs > 0)
+        outlen += g722_qmf_synthesis(s, qmf_buf, qmf_pairs, &amp[outlen]);
     return outlen;
 }
 /*- End of function --------------------------------------------------------*/
@@ -38,6 +38,7 @@
 #endif
 
 #include "g722.h"
+#include "g722_qmf.h"
 
 #if !defined(FALSE)
 #define FALSE 0
@@ -232,10 +233,6 @@ int g722_encode(g722_encode_state_t *s, uint8_t g722_data[], const int16_t amp[]
     {
         -7408,  -1616,   7408,   1616
     };
-    static const int qmf_coeffs[12] =
-    {
-           3,  -11,   12,   32, -210,  951, 3876, -805,  362, -156,   53,  -11,
-    };
     static const int ihn[3] = {0, 1, 0};
     static const int ihp[3] = {0, 3, 2};
     static const int wh[3] = {0, -214, 798};
@@ -265,8 +262,16 @@ int g722_encode(g722_encode_state_t *s, uint8_t g722_data[], const int16_t amp[]
     int ihigh;
     int ilow;
     int code;
+    /* Vectorized QMF: history and chunk of samples, and sums of the chunk */
+    int16_t qmf_buf[G722_QMF_HISTORY + 2*G722_QMF_CHUNK];
+    int32_t qmf_sumodd[G722_QMF_CHUNK];
+    int32_t qmf_sumeven[G722_QMF_CHUNK];
+    int qmf_pairs;
+    int qmf_pair;
 
     g722_bytes = 0;
+    qmf_pairs = 0;
+    qmf_pair = 0;
     xhigh = 0;
     for (j = 0;  j < len;  )
     {
@@ -283,21 +288,25 @@ int g722_encode(g722_encode_state_t *s, uint8_t g722_data[], const int16_t amp[]
             }
             else
             {
-                /* Apply the transmit QMF */
-                /* Shuffle the buffer down */
-                for (i = 0;  i < 22;  i++)
-                    s->x[i] = s->x[i + 2];
-                s->x[22] = amp[j++];
-                s->x[23] = amp[j++];
-    
-                /* Discard every other QMF output */
-                sumeven = 0;
-                sumodd = 0;
-                for (i = 0;  i < 12;  i++)
+                /* Apply the transmit QMF (vectorized, see g722_qmf.h): a chunk of sample pairs at once */
+                if (qmf_pair == qmf_pairs)
                 {
-                    sumodd += s->x[2*i]*qmf_coeffs[i];
-                    sumeven += s->x[2*i + 1]*qmf_coeffs[11 - i];
+                    qmf_pairs = (len - j) >> 1;
+                    if (qmf_pairs == 0)
+                        break;
+                    if (qmf_pairs > G722_QMF_CHUNK)
+                        qmf_pairs = G722_QMF_CHUNK;
+                    g722_qmf_load(s->x, qmf_buf);
+                    memcpy(&qmf_buf[G722_QMF_HISTORY], &amp[j], 2*qmf_pairs*sizeof(int16_t));
+                    g722_qmf_filter(qmf_buf, qmf_pairs, qmf_sumodd, qmf_sumeven);
+                    g722_qmf_store(s->x, qmf_buf, qmf_pairs);
+                    qmf_pair = 0;
                 }
+                j += 2;
+
+                /* Discard every other QMF output */
+                sumodd = qmf_sumodd[qmf_pair];
+                sumeven = qmf_sumeven[qmf_pair++];
                 xlow = (sumeven + sumodd) >> 14;
                 xhigh = (sumeven - sumodd) >> 14;
             }
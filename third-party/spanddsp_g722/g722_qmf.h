@@ -0,0 +1,112 @@
+/**
+@file g722_qmf.h
+@author Frank Haase, Dennis Guse
+@date 2026-10-16
+@license GPLv3 or later
+
+Vectorized QMF (24 taps) of the G.722 encoder (analysis) and decoder (synthesis); modification of spandsp.
+
+Instead of shifting the signal history (int x[24]) per pair of samples, a chunk of sample pairs is filtered at once on a contiguous buffer (history and new samples).
+Both sums per pair (even and odd taps) are computed exactly (32 bit integer), so the result is bit-exact with the original implementation.
+
+The implementation is selected at build time: AVX2, SSE2, NEON or scalar.
+
+Developer note: the samples are stored as int16_t (encoder: input; decoder: rlow + rhigh and rlow - rhigh, which are limited to 15 bit each).
+Developer note: benchmark (and comparison with the original implementation): tests/benchmark_g722_qmf.c.
+
+*/
+
+#ifndef G722_QMF_H_
+#define G722_QMF_H_
+
+#include <stdint.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#define G722_QMF_HISTORY 22     //Samples of the history (x[2..23])
+#define G722_QMF_CHUNK 128      //Maximal number of sample pairs per call
+
+static const int g722_qmf_coeffs[12] = {
+  3, -11, 12, 32, -210, 951, 3876, -805, 362, -156, 53, -11,
+};
+
+//Copies the history of the QMF into the buffer (buf[0..G722_QMF_HISTORY)).
+static inline void g722_qmf_load (const int x[24], int16_t buf[]) {
+  for (int i = 0; i < G722_QMF_HISTORY; i++) {
+    buf[i] = (int16_t) x[i + 2];
+  }
+}
+
+//Stores the window of the last pair (buf[2 * (pairs - 1)..]) as history of the QMF (identical to the original implementation).
+static inline void g722_qmf_store (int x[24], const int16_t buf[], int pairs) {
+  for (int i = 0; i < 24; i++) {
+    x[i] = buf[2 * (pairs - 1) + i];
+  }
+}
+
+/*
+Filters pairs of samples: buf contains the history (G722_QMF_HISTORY samples) followed by 2 * pairs new samples.
+For pair k (window buf[2k..2k + 23]): sumodd[k] = sum(buf[2k + 2i] * coeffs[i]); sumeven[k] = sum(buf[2k + 2i + 1] * coeffs[11 - i]).
+*/
+static inline void g722_qmf_filter (const int16_t buf[], int pairs, int32_t sumodd[], int32_t sumeven[]) {
+  int k = 0;
+
+#if defined(__AVX2__)
+  //One 32 bit lane per pair: multiply-add of (even tap, odd tap) with (coeffs[i], 0) and (0, coeffs[11 - i])
+  for (; k + 8 <= pairs; k += 8) {
+    __m256i odd = _mm256_setzero_si256 ();
+    __m256i even = _mm256_setzero_si256 ();
+    for (int i = 0; i < 12; i++) {
+      __m256i samples = _mm256_loadu_si256 ((const __m256i *) &buf[2 * (k + i)]);
+      odd = _mm256_add_epi32 (odd, _mm256_madd_epi16 (samples, _mm256_set1_epi32 ((uint16_t) g722_qmf_coeffs[i])));
+      even = _mm256_add_epi32 (even, _mm256_madd_epi16 (samples, _mm256_set1_epi32 ((int32_t) ((uint32_t) (uint16_t) g722_qmf_coeffs[11 - i] << 16))));
+    }
+    _mm256_storeu_si256 ((__m256i *) & sumodd[k], odd);
+    _mm256_storeu_si256 ((__m256i *) & sumeven[k], even);
+  }
+#elif defined(__SSE2__)
+  for (; k + 4 <= pairs; k += 4) {
+    __m128i odd = _mm_setzero_si128 ();
+    __m128i even = _mm_setzero_si128 ();
+    for (int i = 0; i < 12; i++) {
+      __m128i samples = _mm_loadu_si128 ((const __m128i *) &buf[2 * (k + i)]);
+      odd = _mm_add_epi32 (odd, _mm_madd_epi16 (samples, _mm_set1_epi32 ((uint16_t) g722_qmf_coeffs[i])));
+      even = _mm_add_epi32 (even, _mm_madd_epi16 (samples, _mm_set1_epi32 ((int32_t) ((uint32_t) (uint16_t) g722_qmf_coeffs[11 - i] << 16))));
+    }
+    _mm_storeu_si128 ((__m128i *) & sumodd[k], odd);
+    _mm_storeu_si128 ((__m128i *) & sumeven[k], even);
+  }
+#elif defined(__ARM_NEON)
+  //De-interleaving load: val[0] even taps, val[1] odd taps
+  for (; k + 4 <= pairs; k += 4) {
+    int32x4_t odd = vdupq_n_s32 (0);
+    int32x4_t even = vdupq_n_s32 (0);
+    for (int i = 0; i < 12; i++) {
+      int16x4x2_t samples = vld2_s16 (&buf[2 * (k + i)]);
+      odd = vmlal_n_s16 (odd, samples.val[0], g722_qmf_coeffs[i]);
+      even = vmlal_n_s16 (even, samples.val[1], g722_qmf_coeffs[11 - i]);
+    }
+    vst1q_s32 (&sumodd[k], odd);
+    vst1q_s32 (&sumeven[k], even);
+  }
+#endif
+
+  for (; k < pairs; k++) {
+    int32_t odd = 0;
+    int32_t even = 0;
+    for (int i = 0; i < 12; i++) {
+      odd += buf[2 * (k + i)] * g722_qmf_coeffs[i];
+      even += buf[2 * (k + i) + 1] * g722_qmf_coeffs[11 - i];
+    }
+    sumodd[k] = odd;
+    sumeven[k] = even;
+  }
+}
+
+#endif /* G722_QMF_H_ */